@@ -1,5 +1,6 @@
 #pragma once
 #include "task.hpp"
+#include "search_control.hpp"
 #include <iostream>
 #include <vector>
 
@@ -34,7 +35,7 @@ Array extract_solution(const Node& node) {
     return result;
 }
 
-Array extract_solution_finished(const TaskSequencingProblem task, const Node& node, std::vector<std::vector<Array>>& joint_space_solution) {
+Array extract_solution_finished(const TaskSequencingProblem& task, const Node& node, std::vector<std::vector<Array>>& joint_space_solution) {
     Array result(node.n_affected_tasks);
     joint_space_solution.resize(task.joint_space_tasks.size() + task.cartesian_space_tasks.size());
     auto current_node = node;
@@ -60,7 +61,31 @@ Array extract_solution_finished(const TaskSequencingProblem task, const Node& no
     return result;
 }
 
-bool is_consistent(TaskSequencingProblem task, Node node) {
+// Motions to execute a solution: from the start position to the first task, then between consecutive tasks.
+// note: Requires setup() with a cost_model and cache_profiles, nothing is recomputed.
+std::vector<MotionProfile> extract_motion_profiles(const TaskSequencingProblem& task, const Array& solution) {
+    int n_tasks = task.working_set.size();
+    if (task.profiles.size() != (size_t)n_tasks*n_tasks || task.profiles_from_start.size() != n_tasks) {
+        std::cerr << "Error : Profiles were not cached, set cost_model and cache_profiles before setup()" << std::endl;
+        return {};
+    }
+    if (solution.size == 0) {
+        return {};
+    }
+
+    std::vector<MotionProfile> result;
+    result.reserve(solution.size);
+    result.push_back(task.profiles_from_start[(int)solution[0]]);
+    for (int i = 1; i < solution.size; i++) {
+        // cost(row, col) is the motion from the end of col to the start of row
+        int from = solution[i-1];
+        int to = solution[i];
+        result.push_back(task.profiles[(size_t)to*n_tasks + from]);
+    }
+    return result;
+}
+
+bool is_consistent(const TaskSequencingProblem& task, const Node& node) {
     auto candidate = extract_solution(node);
 
     auto order_constraints = task.order_constraints;
@@ -133,7 +158,13 @@ bool is_consistent(TaskSequencingProblem task, Node node) {
     return true;
 }
 
-Array A_star(TaskSequencingProblem task, bool* success, std::vector<std::vector<Array>>* joint_space_solution = nullptr) {
+// With a control, the search stops (success false) once it runs out of time or nodes or is cancelled, see
+// control->status. The bound it reports is the total cost of the node expanded, a lower bound of the optimal cost.
+Array A_star(const TaskSequencingProblem& task, bool* success, std::vector<std::vector<Array>>* joint_space_solution = nullptr, SearchControl* control = nullptr) {
+    TRACE_ZONE("A_star");
+    if (control) {
+        control->start();
+    }
     int n_tasks = task.working_set.size();
     int n_clusters = task.joint_space_tasks.size() + 2*task.cartesian_space_tasks.size();
     
@@ -162,18 +193,30 @@ Array A_star(TaskSequencingProblem task, bool* success, std::vector<std::vector<
 
     
     while (true) {
+        TRACE_ZONE("A_star expand");
+        TRACE_COUNTER("A_star active nodes", active_nodes.size());
         // STOPPING CRITERIA: If no more active nodes, that means no solutions are possible
         if (active_nodes.size() == 0) {
             *success = false;
+            if (control) {
+                control->finish();
+            }
             return {};
         }
         
         // Expand lowest value node (first in line)
         auto current_node = active_nodes.front();
+        if (control && !control->poll(current_node.total_cost)) {
+            *success = false;
+            return {};
+        }
         
         // STOPPING CRITERIA: if current node is end node, that means we found optimal solution
         if (current_node.n_affected_tasks == n_clusters) {
             *success = true;
+            if (control) {
+                control->finish();
+            }
             if (joint_space_solution) {
                 return extract_solution_finished(task, current_node, *joint_space_solution);
             } else {
@@ -1,169 +1,2335 @@
+#pragma once
+#include "search_control.hpp"
+#include "tracing.hpp"
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <type_traits>
 #include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 struct CSP_Variable;
 
+// Word helpers shared by the bitset domains
+inline int csp_popcount(uint64_t word) {
+#if defined(_MSC_VER)
+    return (int)__popcnt64(word);
+#else
+    return __builtin_popcountll(word);
+#endif
+}
+
+// Index of the lowest set bit, word must not be 0
+inline int csp_lowest_bit(uint64_t word) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return (int)index;
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+inline int csp_count(const uint64_t* words, int n_words) {
+    int count = 0;
+    for (int w = 0; w < n_words; w++) {
+        count += csp_popcount(words[w]);
+    }
+    return count;
+}
+
+// Smallest value > after in the set, -1 if there is none
+inline int csp_next(const uint64_t* words, int n_words, int after) {
+    int x = after + 1;
+    int w = x >> 6;
+    if (w >= n_words) {
+        return -1;
+    }
+    uint64_t word = words[w] & (~0ull << (x & 63));
+    while (word == 0) {
+        if (++w == n_words) {
+            return -1;
+        }
+        word = words[w];
+    }
+    return (w << 6) + csp_lowest_bit(word);
+}
+
+// Largest value in the set, -1 if it is empty
+inline int csp_last(const uint64_t* words, int n_words) {
+    for (int w = n_words - 1; w >= 0; w--) {
+        if (words[w] != 0) {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanReverse64(&index, words[w]);
+            return (w << 6) + (int)index;
+#else
+            return (w << 6) + 63 - __builtin_clzll(words[w]);
+#endif
+        }
+    }
+    return -1;
+}
+
+// Set of values in [0, capacity), one bit per value: O(1) insert, erase and contains.
+// note: Values must be non negative, -1 is used by the solvers for "no value".
 struct CSP_Domain {
-    std::vector<int> domain;
+    std::vector<uint64_t> words;
+    int capacity = 0;
+
+    CSP_Domain() = default;
+    CSP_Domain(int new_capacity, bool full = false)
+        : words((new_capacity + 63) / 64, 0), capacity(new_capacity) {
+            if (full) {
+                fill();
+            }
+        }
+
+    void insert(int x) {
+        if (x >= capacity) {
+            capacity = x + 1;
+            words.resize((capacity + 63) / 64, 0);
+        }
+        words[x >> 6] |= 1ull << (x & 63);
+    }
+    void erase(int x) { words[x >> 6] &= ~(1ull << (x & 63)); }
+    bool contains(int x) const { return x >= 0 && x < capacity && (words[x >> 6] >> (x & 63)) & 1; }
+
+    int size() const { return csp_count(words.data(), words.size()); }
+    bool empty() const {
+        for (auto word : words) {
+            if (word != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int first() const { return csp_next(words.data(), words.size(), -1); }
+    int next(int after) const { return csp_next(words.data(), words.size(), after); }
+    int last() const { return csp_last(words.data(), words.size()); }
+
+    // Word at a time, values other lacks are removed
+    void intersect(const CSP_Domain& other) {
+        for (int w = 0; w < words.size(); w++) {
+            words[w] &= w < other.words.size() ? other.words[w] : 0;
+        }
+    }
+
+    void fill() {
+        for (auto& word : words) {
+            word = ~0ull;
+        }
+        if (capacity & 63) {
+            words.back() = (1ull << (capacity & 63)) - 1;
+        }
+    }
+
+    void clear() {
+        for (auto& word : words) {
+            word = 0;
+        }
+    }
+};
+
+// Same interface as CSP_Domain for values in [0, N), without heap storage
+template <int N>
+struct CSP_FixedDomain {
+    static constexpr int N_WORDS = (N + 63) / 64;
+    uint64_t words[N_WORDS] = {};
+
+    CSP_FixedDomain(bool full = false) {
+        if (full) {
+            fill();
+        }
+    }
+
+    void insert(int x) { words[x >> 6] |= 1ull << (x & 63); }
+    void erase(int x) { words[x >> 6] &= ~(1ull << (x & 63)); }
+    bool contains(int x) const { return x >= 0 && x < N && (words[x >> 6] >> (x & 63)) & 1; }
+
+    int size() const { return csp_count(words, N_WORDS); }
+    bool empty() const {
+        for (int w = 0; w < N_WORDS; w++) {
+            if (words[w] != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int first() const { return csp_next(words, N_WORDS, -1); }
+    int next(int after) const { return csp_next(words, N_WORDS, after); }
+    int last() const { return csp_last(words, N_WORDS); }
+
+    void intersect(const CSP_FixedDomain& other) {
+        for (int w = 0; w < N_WORDS; w++) {
+            words[w] &= other.words[w];
+        }
+    }
+
+    void fill() {
+        for (int w = 0; w < N_WORDS; w++) {
+            words[w] = ~0ull;
+        }
+        if (N & 63) {
+            words[N_WORDS - 1] = (1ull << (N & 63)) - 1;
+        }
+    }
+
+    void clear() {
+        for (int w = 0; w < N_WORDS; w++) {
+            words[w] = 0;
+        }
+    }
+};
+
+// Read only view of the current assignment, value of variable i is a[i] (-1 when unassigned)
+struct CSP_Assignment {
+    const int* values = nullptr;
+    int size = 0;
+
+    int operator[](int i) const { return values[i]; }
 };
 
 struct CSP_Constraint {
     std::vector<CSP_Variable*> input_var;
     std::vector<CSP_Variable*> output_var;
+    int idx = -1; // Position in CSP::constraints, set when a search starts
 
-    virtual bool consistent(std::vector<int> a, int x) = 0; // Pure virtual
+    virtual bool consistent(CSP_Assignment a, int x) = 0; // Pure virtual
     virtual ~CSP_Constraint() = default;
 };
 
+// The solvers are templated on the constraint type. With a concrete type, consistent() is called without virtual
+// dispatch (qualified call), so its body is inlined in the search loops. Every constraint of the problem must then be
+// of that type. With CSP_Constraint (the default), problems mixing constraint types go through the virtual call.
+template <typename Constraint>
+inline bool csp_consistent(CSP_Constraint* cons, CSP_Assignment a, int x) {
+    if constexpr (std::is_same<Constraint, CSP_Constraint>::value) {
+        return cons->consistent(a, x);
+    } else {
+        return static_cast<Constraint*>(cons)->Constraint::consistent(a, x);
+    }
+}
+
+struct CSP;
+
+// Constraint over any number of variables, filtered as a whole by its own propagator instead of value by value.
+// Registered in the globals of its variables and owned by CSP::global_constraints.
+// note: Both functions treat an assigned variable (CSP::result) as having only its value, whatever its domain holds,
+// and only remove values of unassigned variables. Like consistent(), they may run on several threads at once: state
+// that changes during the search lives in the reversible words of the CSP (CSP::set_word()).
+struct CSP_GlobalConstraint {
+    std::vector<CSP_Variable*> scope;
+    int idx = -1;         // Position in CSP::global_constraints, set when a search starts
+    int word_offset = 0;  // First of its reversible words in CSP::global_words, set when a search starts
+
+    virtual int n_words() const { return 0; }
+    virtual void start(CSP&) {} // Initial value of its reversible words
+
+    // False when the assigned variables of the scope already violate the constraint
+    virtual bool check(const CSP& csp) = 0;
+    // Removes values of unassigned variables of the scope without support, with CSP::remove_value(). Returns false
+    // when there is no way to satisfy the constraint anymore.
+    virtual bool propagate(CSP& csp) = 0;
+    virtual ~CSP_GlobalConstraint() = default;
+};
+
 struct CSP_Variable {
     CSP_Domain domain;
     std::vector<CSP_Constraint*> from_arcs;
     std::vector<CSP_Constraint*> to_arcs;
+    std::vector<CSP_GlobalConstraint*> globals;
+    int idx = -1; // Position in CSP::variables, set when a search starts
+};
+
+// Constraint seen from one of its variables
+struct CSP_Arc {
+    CSP_Constraint* constraint;
+    int idx;   // Position of the constraint in CSP::constraints
+    int other; // Other variable of a binary constraint, -1 for other constraints
+};
+
+// Constraint graph in compressed sparse row form, built by CSP::finalize() from the from_arcs, to_arcs and globals of
+// the variables. The search loops walk these arrays instead of following pointers from variables to constraints and
+// back to variables.
+// note: Parameters of a constraint stay in the constraint object, since only its consistent() knows them.
+struct CSP_Graph {
+    // Arcs of variable v: its from_arcs in arcs[arc_offsets[v]] .. arcs[to_offsets[v] - 1], then its to_arcs up to
+    // arcs[arc_offsets[v+1] - 1]
+    std::vector<int> arc_offsets;
+    std::vector<int> to_offsets;
+    std::vector<CSP_Arc> arcs;
+    // Variables of constraint c: its inputs in scope[scope_offsets[c]] .. scope[output_offsets[c] - 1], then its
+    // outputs up to scope[scope_offsets[c+1] - 1]
+    std::vector<int> scope_offsets;
+    std::vector<int> output_offsets;
+    std::vector<int> scope;
+    // Binary constraint c links binary_input[c] to binary_output[c], both -1 for other constraints
+    std::vector<int> binary_input;
+    std::vector<int> binary_output;
+    // Global constraints of variable v are globals[global_offsets[v]] .. globals[global_offsets[v+1] - 1]
+    std::vector<int> global_offsets;
+    std::vector<int> globals;
+};
+
+// Removal of value from the search domain of variable (an index), undone when backtracking. Entries with a negative
+// variable restore global word -1 - variable to saved_words[value] instead.
+struct CSP_TrailEntry {
+    int variable;
+    int value;
+};
+
+// Assignment variable = value
+struct CSP_Literal {
+    int variable;
+    int value;
+};
+
+// Literals that cannot all hold in a solution, learned by CSP::backtrack_cbj()
+struct CSP_Nogood {
+    std::vector<CSP_Literal> literals;
+    int watched[2] = {0, 0}; // Positions in literals, the nogood is only checked when one of these two starts to hold
+};
+
+// Open subtree of a parallel search (see csp_parallel.hpp): the assignments above it, then the values left to try for
+// the variable of its first level
+struct CSP_Subtree {
+    std::vector<CSP_Literal> path;
+    int variable = -1; // -1 for the whole search tree
+    CSP_Domain values;
+};
+
+// Arc consistency algorithm used by arc_consistency() and backtrack_mac()
+enum class CSP_Propagation {
+    ac3,   // Revising an arc searches supports from the first value
+    ac2001 // Each value keeps its last support, checked first, and the search for a new one resumes after it
+};
+
+// Which variable the search assigns next
+enum class CSP_VariableOrdering {
+    input,      // Order of CSP::variables
+    mrv,        // Minimum remaining values: smallest domain first
+    mrv_degree, // Minimum remaining values, ties broken by the most constraints with unassigned variables
+    dom_wdeg    // Smallest domain size over weighted degree, a constraint weighs 1 + the number of wipeouts it caused
+};
+
+// Which value of the variable is tried next
+enum class CSP_ValueOrdering {
+    input, // Increasing values
+    lcv    // Least constraining value: fewest values removed from the domains of unassigned neighbors
+};
+
+// Inference done by the search after each assignment
+enum class CSP_Inference {
+    none,
+    forward_checking,
+    mac
 };
 
 struct CSP {
     std::vector<std::unique_ptr<CSP_Variable>> variables;
     std::vector<std::unique_ptr<CSP_Constraint>> constraints;
+    std::vector<std::unique_ptr<CSP_GlobalConstraint>> global_constraints;
     std::vector<int> result;
-;
 
-    int select_value(CSP_Variable* current_variable) {
-        while (current_variable->domain.domain.size() > 0) {
-            auto x = current_variable->domain.domain[0];
-            current_variable->domain.domain.erase(current_variable->domain.domain.begin());
+    // Model as the search reads it, set by finalize(). Parallel workers borrow the views of the problem they search,
+    // their own variables and constraints stay empty.
+    std::vector<CSP_Variable*> model_variables;
+    std::vector<CSP_Constraint*> model_constraints;
+    std::vector<CSP_GlobalConstraint*> model_globals;
+    CSP_Graph graph;
+    int n_global_words = 0;
+    bool borrowed_model = false;
 
-            bool consistent = true;
-            for (auto cons : current_variable->to_arcs) {
-                if (!cons->consistent(result, x)) {
-                    consistent = false;
-                    break;
-                }
+    CSP_VariableOrdering variable_ordering = CSP_VariableOrdering::input;
+    CSP_ValueOrdering value_ordering = CSP_ValueOrdering::input;
+    CSP_Propagation propagation = CSP_Propagation::ac2001;
+
+    // Search state. Domains are copied from the variables once per search, the variables themselves are left untouched.
+    // Every removal goes on the trail, so that backtracking restores exactly what changed since a mark.
+    std::vector<CSP_Domain> domains;
+    std::vector<CSP_TrailEntry> trail;
+    std::vector<int> level_marks; // Trail size when the search reached each level
+    std::vector<int> value_marks; // Trail size once the current value of the variable of each level was taken out of its domain
+
+    // Ordering state. Degrees only count binary constraints.
+    std::vector<int> order; // Variable assigned at each level
+    std::vector<char> assigned;
+    std::vector<int> sizes; // Domain sizes, kept up to date by remove_value() and undo_to()
+    std::vector<int> future_degree;   // Binary constraints whose other variable is unassigned
+    std::vector<int> weights;         // Per constraint, for dom/wdeg
+    std::vector<int> weighted_degree; // Same as future_degree, with weights
+    std::vector<std::vector<int>> level_values; // Values of each level, in LCV order
+    std::vector<int> value_cursor;
+    std::vector<char> donated; // Values left at each level were handed over to another worker
+
+    // Value symmetries: mapping value x of every variable to symmetry[x] maps solutions to solutions, like the
+    // reflection x -> n-1-x of N-Queens rows. Together with the identity, they must form a group.
+    // enumerate_solutions() then only visits solutions that are lexicographically smallest among their images.
+    std::vector<std::vector<int>> value_symmetries;
+    bool breaking_symmetries = false;
+    std::vector<char> symmetry_tied; // [level*n_symmetries + s]: the assignment above level is its own image under s
+    std::vector<std::pair<int, int>> value_scores;
+
+    // Unassigned variables sit in buckets by domain size (intrusive doubly linked lists), so that the smallest domains
+    // are found without scanning every variable. Only maintained for mrv and mrv_degree.
+    std::vector<int> bucket_head;
+    std::vector<int> bucket_next;
+    std::vector<int> bucket_prev;
+    int min_bucket = 0; // No unassigned variable has a smaller domain
+
+    // dom/wdeg keeps unassigned variables in a binary heap instead, best first (see wdeg_before()): weights reorder
+    // variables of different sizes, so buckets would still have to be scanned. The heap is ordered on the size and
+    // weighted degree of each variable when it was last sifted. Changes only mark the variable dirty, select_variable()
+    // then sifts each dirty variable once in O(log n), or rebuilds the heap when most of it is dirty.
+    std::vector<int> wdeg_heap;
+    std::vector<int> wdeg_position; // Of each variable in wdeg_heap, -1 when it is not in it
+    std::vector<int> wdeg_sizes;    // Keys of the heap
+    std::vector<int> wdeg_degrees;
+    std::vector<long long> wdeg_stamps; // Ties go to the variable sifted last, like the most recent one of a bucket
+    long long wdeg_clock = 0;
+    std::vector<int> wdeg_dirty;
+    std::vector<char> wdeg_is_dirty;
+
+    // Arc consistency state, arc 2*c revises the output of binary constraint c against its input and arc 2*c + 1
+    // the other way around. Other constraints are only checked once their inputs are assigned.
+    std::vector<int> arc_queue;
+    std::vector<char> arc_queued;
+    std::vector<int> arc_assignment;  // Scratch assignment for checking a pair of values
+    std::vector<int> residue_offsets; // Last support of value v for arc a is at residues[residue_offsets[a] + v]
+    std::vector<int> residues;
+    bool propagating_arcs = false; // Global constraint removals also queue arcs (MAC)
+
+    // Global constraint state: queue of constraints to propagate, and reversible words
+    std::vector<int> global_queue;
+    std::vector<char> global_queued;
+    std::vector<uint64_t> global_words;
+    std::vector<uint64_t> saved_words;
+
+    // Backjumping state, levels are positions in order[]
+    int nogood_capacity = 0; // Nogoods kept by backtrack_cbj(), the oldest is replaced when full. 0 disables learning.
+    int max_nogood_size = 8; // Longer nogoods rarely prune anything and are not recorded
+    std::vector<int> level_of; // Level of each assigned variable, -1 otherwise
+    std::vector<CSP_Domain> conflict_sets; // Levels whose values conflicted with the values tried at each level
+    std::vector<CSP_Nogood> nogoods;
+    int oldest_nogood = 0;
+    std::vector<int> watch_offsets; // Nogoods watching variable = value are in watch_lists[watch_offsets[variable] + value]
+    std::vector<std::vector<int>> watch_lists;
+
+    // Numbers variables and constraints, points the search to them and builds the constraint graph. Runs when a search
+    // starts on a model that was not finalized yet, and must be called again after changing from_arcs, to_arcs or
+    // globals of a finalized model without adding variables or constraints.
+    void finalize() {
+        int n_variables = variables.size();
+        int n_constraints = constraints.size();
+        model_variables.resize(n_variables);
+        for (int i = 0; i < n_variables; i++) {
+            variables[i]->idx = i;
+            model_variables[i] = variables[i].get();
+        }
+        model_constraints.resize(n_constraints);
+        for (int c = 0; c < n_constraints; c++) {
+            constraints[c]->idx = c;
+            model_constraints[c] = constraints[c].get();
+        }
+        model_globals.resize(global_constraints.size());
+        n_global_words = 0;
+        for (int g = 0; g < global_constraints.size(); g++) {
+            global_constraints[g]->idx = g;
+            global_constraints[g]->word_offset = n_global_words;
+            n_global_words += global_constraints[g]->n_words();
+            model_globals[g] = global_constraints[g].get();
+        }
+
+        graph.scope_offsets.assign(n_constraints + 1, 0);
+        graph.output_offsets.assign(n_constraints, 0);
+        graph.binary_input.assign(n_constraints, -1);
+        graph.binary_output.assign(n_constraints, -1);
+        graph.scope.clear();
+        for (int c = 0; c < n_constraints; c++) {
+            auto cons = model_constraints[c];
+            for (auto var : cons->input_var) {
+                graph.scope.push_back(var->idx);
             }
-            if (consistent) {
-                return x;
+            graph.output_offsets[c] = graph.scope.size();
+            for (auto var : cons->output_var) {
+                graph.scope.push_back(var->idx);
+            }
+            graph.scope_offsets[c + 1] = graph.scope.size();
+            if (cons->input_var.size() == 1 && cons->output_var.size() == 1) {
+                graph.binary_input[c] = cons->input_var[0]->idx;
+                graph.binary_output[c] = cons->output_var[0]->idx;
             }
         }
-        return -1;
+
+        graph.arc_offsets.assign(n_variables + 1, 0);
+        graph.to_offsets.assign(n_variables, 0);
+        graph.global_offsets.assign(n_variables + 1, 0);
+        graph.arcs.clear();
+        graph.globals.clear();
+        for (int i = 0; i < n_variables; i++) {
+            for (auto cons : model_variables[i]->from_arcs) {
+                graph.arcs.push_back({cons, cons->idx, graph.binary_output[cons->idx]});
+            }
+            graph.to_offsets[i] = graph.arcs.size();
+            for (auto cons : model_variables[i]->to_arcs) {
+                graph.arcs.push_back({cons, cons->idx, graph.binary_input[cons->idx]});
+            }
+            graph.arc_offsets[i + 1] = graph.arcs.size();
+            for (auto global : model_variables[i]->globals) {
+                graph.globals.push_back(global->idx);
+            }
+            graph.global_offsets[i + 1] = graph.globals.size();
+        }
+    }
+
+    bool finalized() const {
+        return model_variables.size() == variables.size() && model_constraints.size() == constraints.size() && model_globals.size() == global_constraints.size() && graph.arc_offsets.size() == variables.size() + 1;
+    }
+
+    // Searches the model of problem, which must be finalized and outlive this one
+    void borrow_model(const CSP& problem) {
+        model_variables = problem.model_variables;
+        model_constraints = problem.model_constraints;
+        model_globals = problem.model_globals;
+        graph = problem.graph;
+        n_global_words = problem.n_global_words;
+        borrowed_model = true;
+        variable_ordering = problem.variable_ordering;
+        value_ordering = problem.value_ordering;
+        propagation = problem.propagation;
     }
 
-    std::vector<int> backtrack() {
-        result.resize(variables.size());
-        
-        std::vector<CSP_Domain> domains;
-        domains.reserve(variables.size());
-        
-        for (int i = 0; i < variables.size(); i++) {
-            domains.push_back(variables[i].get()->domain);
+    void start_search() {
+        if (!borrowed_model && !finalized()) {
+            finalize();
         }
-        
-        int i = 0;
-        while (i >= 0 && i < variables.size()) {
-            int current_value = select_value(variables[i].get());
-            result[i] = current_value;
-            if (current_value == -1) {
-                for (int j = i; j < variables.size(); j++) {
-                    variables[j].get()->domain = domains[j];
-                }
-                i = i-1;
+        int n_variables = model_variables.size();
+        result.assign(n_variables, -1);
+        domains.clear();
+        domains.reserve(n_variables);
+        for (int i = 0; i < n_variables; i++) {
+            domains.push_back(model_variables[i]->domain);
+        }
+        trail.clear();
+        propagating_arcs = false;
+        global_queue.clear();
+        global_queued.assign(model_globals.size(), 0);
+        global_words.assign(n_global_words, 0);
+        saved_words.clear();
+        for (auto global : model_globals) {
+            global->start(*this);
+        }
+        level_marks.assign(n_variables + 1, 0);
+        value_marks.assign(n_variables + 1, 0);
+        arc_assignment.assign(n_variables, -1);
+
+        order.assign(n_variables + 1, -1);
+        assigned.assign(n_variables, 0);
+        level_of.assign(n_variables, -1);
+        sizes.resize(n_variables);
+        future_degree.assign(n_variables, 0);
+        weights.assign(model_constraints.size(), 1);
+        level_values.resize(n_variables + 1);
+        value_cursor.assign(n_variables + 1, 0);
+        donated.assign(n_variables + 1, 0);
+        symmetry_tied.assign((n_variables + 1)*value_symmetries.size(), 1);
+        int max_size = 0;
+        for (int i = 0; i < n_variables; i++) {
+            sizes[i] = domains[i].size();
+            max_size = sizes[i] > max_size ? sizes[i] : max_size;
+            for (int a = graph.arc_offsets[i]; a < graph.arc_offsets[i + 1]; a++) {
+                future_degree[i] += graph.arcs[a].other != -1;
             }
-            else {
-                i = i+1;
+        }
+        weighted_degree = future_degree;
+
+        bucket_head.assign(max_size + 1, -1);
+        bucket_next.assign(n_variables, -1);
+        bucket_prev.assign(n_variables, -1);
+        min_bucket = max_size;
+        wdeg_heap.clear();
+        wdeg_position.assign(n_variables, -1);
+        wdeg_sizes.resize(n_variables);
+        wdeg_degrees.resize(n_variables);
+        wdeg_stamps.resize(n_variables);
+        wdeg_clock = 0;
+        wdeg_dirty.clear();
+        wdeg_is_dirty.assign(n_variables, 0);
+        if (uses_buckets()) {
+            for (int i = n_variables - 1; i >= 0; i--) {
+                bucket_insert(i);
+            }
+        } else if (variable_ordering == CSP_VariableOrdering::dom_wdeg) {
+            // Like buckets, ties first go to the smallest index
+            for (int i = n_variables - 1; i >= 0; i--) {
+                wdeg_push(i);
             }
         }
-        if (i == -1) {
-            return {};
+    }
+
+    bool uses_buckets() const {
+        return variable_ordering == CSP_VariableOrdering::mrv || variable_ordering == CSP_VariableOrdering::mrv_degree;
+    }
+
+    void bucket_insert(int variable) {
+        int size = sizes[variable];
+        bucket_prev[variable] = -1;
+        bucket_next[variable] = bucket_head[size];
+        if (bucket_head[size] != -1) {
+            bucket_prev[bucket_head[size]] = variable;
+        }
+        bucket_head[size] = variable;
+        min_bucket = size < min_bucket ? size : min_bucket;
+    }
+
+    void bucket_erase(int variable) {
+        if (bucket_prev[variable] != -1) {
+            bucket_next[bucket_prev[variable]] = bucket_next[variable];
         } else {
-            return result;
+            bucket_head[sizes[variable]] = bucket_next[variable];
+        }
+        if (bucket_next[variable] != -1) {
+            bucket_prev[bucket_next[variable]] = bucket_prev[variable];
         }
     }
-    
-    int select_value_fc(CSP_Variable* current_variable, int current_variable_idx) {
-        std::vector<CSP_Domain> domains;
-        domains.reserve(variables.size() - current_variable_idx);
-        
-        for (int i = current_variable_idx; i < variables.size(); i++) {
-            domains.push_back(variables[i].get()->domain);
-        }
-        
-        while (current_variable->domain.domain.size() > 0) {
-            auto x = current_variable->domain.domain[0];
-            current_variable->domain.domain.erase(current_variable->domain.domain.begin());
-            
-            // Variable is consistent with past choices
-            bool consistent = true;
-            for (auto cons : current_variable->to_arcs) {
-                if (!cons->consistent(result, x)) {
-                    consistent = false;
-                    break;
-                }
+
+    // dom/wdeg order on the heap keys: smaller size over weighted degree first, compared as size_a*wdeg_b < size_b*wdeg_a.
+    // Variables without weighted degree come last, by size. Remaining ties go to the variable sifted last.
+    bool wdeg_before(int a, int b) const {
+        bool a_weighted = wdeg_degrees[a] > 0;
+        bool b_weighted = wdeg_degrees[b] > 0;
+        if (a_weighted != b_weighted) {
+            return a_weighted;
+        }
+        long long lhs = a_weighted ? (long long)wdeg_sizes[a]*wdeg_degrees[b] : wdeg_sizes[a];
+        long long rhs = a_weighted ? (long long)wdeg_sizes[b]*wdeg_degrees[a] : wdeg_sizes[b];
+        return lhs != rhs ? lhs < rhs : wdeg_stamps[a] > wdeg_stamps[b];
+    }
+
+    // The size or weighted degree of variable changed, it is sifted by the next select_variable() if it is in the heap
+    void wdeg_touch(int variable) {
+        if (wdeg_position[variable] != -1 && !wdeg_is_dirty[variable]) {
+            wdeg_is_dirty[variable] = 1;
+            wdeg_dirty.push_back(variable);
+        }
+    }
+
+    void wdeg_push(int variable) {
+        wdeg_sizes[variable] = sizes[variable];
+        wdeg_degrees[variable] = weighted_degree[variable];
+        wdeg_stamps[variable] = wdeg_clock++;
+        wdeg_position[variable] = wdeg_heap.size();
+        wdeg_heap.push_back(variable);
+        wdeg_sift_up(wdeg_position[variable]);
+    }
+
+    void wdeg_erase(int variable) {
+        int i = wdeg_position[variable];
+        int last = wdeg_heap.back();
+        wdeg_heap.pop_back();
+        wdeg_position[variable] = -1;
+        if (last != variable) {
+            wdeg_heap[i] = last;
+            wdeg_position[last] = i;
+            wdeg_update(last);
+        }
+    }
+
+    // Restores the heap order around variable after its keys changed
+    void wdeg_update(int variable) {
+        wdeg_sift_up(wdeg_position[variable]);
+        wdeg_sift_down(wdeg_position[variable]);
+    }
+
+    void wdeg_sift_up(int i) {
+        int variable = wdeg_heap[i];
+        while (i > 0) {
+            int up = (i - 1) / 2;
+            if (!wdeg_before(variable, wdeg_heap[up])) {
+                break;
             }
+            wdeg_heap[i] = wdeg_heap[up];
+            wdeg_position[wdeg_heap[i]] = i;
+            i = up;
+        }
+        wdeg_heap[i] = variable;
+        wdeg_position[variable] = i;
+    }
 
-            // Variable is consistent with future variables (no future variable has empty domain) -- Forward Checking
-            auto current_result = result;
-            if (consistent) {
-                current_result[current_variable_idx] = x;
+    void wdeg_sift_down(int i) {
+        int variable = wdeg_heap[i];
+        int n = wdeg_heap.size();
+        while (2*i + 1 < n) {
+            int child = 2*i + 1;
+            if (child + 1 < n && wdeg_before(wdeg_heap[child + 1], wdeg_heap[child])) {
+                child++;
+            }
+            if (!wdeg_before(wdeg_heap[child], variable)) {
+                break;
+            }
+            wdeg_heap[i] = wdeg_heap[child];
+            wdeg_position[wdeg_heap[i]] = i;
+            i = child;
+        }
+        wdeg_heap[i] = variable;
+        wdeg_position[variable] = i;
+    }
 
-                for (auto cons : current_variable->from_arcs) {
-                    consistent = true;
-                    for (int v = 0; v < cons->output_var.size(); v++) {
-                        // remove inconsistent values from domains
-                        for (int d = cons->output_var[v]->domain.domain.size()-1; d >= 0; d--) {
-                            if (!cons->consistent(current_result, cons->output_var[v]->domain.domain[d])) {
-                                cons->output_var[v]->domain.domain.erase(cons->output_var[v]->domain.domain.begin() + d);
-                            }
-                        }
-                        // No more domain : value x is rejected
-                        if (cons->output_var[v]->domain.domain.size() == 0) {
-                            consistent = false;
-                            
-                            // reset all domains
-                            for (int i = current_variable_idx; i < cons->output_var.size(); i++) {
-                                variables[i].get()->domain = domains[i];
-                            }
-                            break;
-                        }
-                    }
-                    if (!consistent) {
-                        break;
+    void resize_domain(int variable, int change) {
+        bool bucketed = uses_buckets() && !assigned[variable];
+        if (bucketed) {
+            bucket_erase(variable);
+        }
+        sizes[variable] += change;
+        if (bucketed) {
+            bucket_insert(variable);
+        } else {
+            wdeg_touch(variable);
+        }
+    }
+
+    void remove_value(int variable, int x) {
+        domains[variable].erase(x);
+        trail.push_back({variable, x});
+        resize_domain(variable, -1);
+    }
+
+    void undo_to(int mark) {
+        while (trail.size() > mark) {
+            auto entry = trail.back();
+            trail.pop_back();
+            if (entry.variable < 0) {
+                global_words[-1 - entry.variable] = saved_words[entry.value];
+                saved_words.pop_back();
+                continue;
+            }
+            domains[entry.variable].insert(entry.value);
+            resize_domain(entry.variable, 1);
+        }
+    }
+
+    // Reversible write of global word index, undone when backtracking like a removal
+    void set_word(int index, uint64_t value) {
+        if (global_words[index] == value) {
+            return;
+        }
+        trail.push_back({-1 - index, (int)saved_words.size()});
+        saved_words.push_back(global_words[index]);
+        global_words[index] = value;
+    }
+
+    CSP_Assignment assignment() const {
+        return {result.data(), (int)result.size()};
+    }
+
+    bool is_binary(int constraint) const {
+        return graph.binary_input[constraint] != -1;
+    }
+
+    bool inputs_assigned(int constraint) const {
+        for (int k = graph.scope_offsets[constraint]; k < graph.output_offsets[constraint]; k++) {
+            if (result[graph.scope[k]] == -1) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Applies f(arc, forward) to the arcs of the binary constraints of variable, forward when variable is the input
+    template <typename F>
+    void for_each_neighbor(int variable, F f) {
+        int to_offset = graph.to_offsets[variable];
+        for (int a = graph.arc_offsets[variable]; a < graph.arc_offsets[variable + 1]; a++) {
+            if (graph.arcs[a].other != -1) {
+                f(graph.arcs[a], a < to_offset);
+            }
+        }
+    }
+
+    bool uses_degrees() const {
+        return variable_ordering == CSP_VariableOrdering::mrv_degree || variable_ordering == CSP_VariableOrdering::dom_wdeg;
+    }
+
+    void assign(int variable) {
+        assigned[variable] = 1;
+        if (uses_buckets()) {
+            bucket_erase(variable);
+        } else if (wdeg_position[variable] != -1) {
+            wdeg_erase(variable);
+        }
+        if (!uses_degrees()) {
+            return;
+        }
+        for_each_neighbor(variable, [&](const CSP_Arc& arc, bool) {
+            future_degree[arc.other]--;
+            weighted_degree[arc.other] -= weights[arc.idx];
+            wdeg_touch(arc.other);
+        });
+    }
+
+    void unassign(int variable) {
+        if (uses_degrees()) {
+            for_each_neighbor(variable, [&](const CSP_Arc& arc, bool) {
+                future_degree[arc.other]++;
+                weighted_degree[arc.other] += weights[arc.idx];
+                wdeg_touch(arc.other);
+            });
+        }
+        assigned[variable] = 0;
+        if (uses_buckets()) {
+            bucket_insert(variable);
+        } else if (variable_ordering == CSP_VariableOrdering::dom_wdeg) {
+            wdeg_push(variable);
+        }
+    }
+
+    // Constraint cons caused a wipeout
+    void bump_weight(int constraint) {
+        weights[constraint]++;
+        if (uses_degrees() && is_binary(constraint)) {
+            int input = graph.binary_input[constraint];
+            int output = graph.binary_output[constraint];
+            weighted_degree[input] += !assigned[output];
+            weighted_degree[output] += !assigned[input];
+            wdeg_touch(input);
+            wdeg_touch(output);
+        }
+    }
+
+    int select_variable(int level) {
+        if (variable_ordering == CSP_VariableOrdering::input) {
+            return level;
+        }
+        if (variable_ordering == CSP_VariableOrdering::dom_wdeg) {
+            // Past a quarter of the heap, one O(n) rebuild is cheaper than sifting every dirty variable
+            bool rebuild = 4*wdeg_dirty.size() > wdeg_heap.size();
+            for (int variable : wdeg_dirty) {
+                wdeg_is_dirty[variable] = 0;
+                if (wdeg_position[variable] != -1) {
+                    wdeg_sizes[variable] = sizes[variable];
+                    wdeg_degrees[variable] = weighted_degree[variable];
+                    wdeg_stamps[variable] = wdeg_clock++;
+                    if (!rebuild) {
+                        wdeg_update(variable);
                     }
                 }
+            }
+            wdeg_dirty.clear();
+            for (int i = rebuild ? (int)wdeg_heap.size()/2 - 1 : -1; i >= 0; i--) {
+                wdeg_sift_down(i);
+            }
+            return wdeg_heap[0];
+        }
+        while (bucket_head[min_bucket] == -1) {
+            min_bucket++;
+        }
+        int best = bucket_head[min_bucket];
+        if (variable_ordering == CSP_VariableOrdering::mrv_degree) {
+            for (int v = bucket_next[best]; v != -1; v = bucket_next[v]) {
+                best = future_degree[v] > future_degree[best] ? v : best;
+            }
+        }
+        return best;
+    }
 
-                if (consistent) {
-                    return x;
+    // Values of variable sorted by the number of values they remove from unassigned neighbors, ties by value
+    template <typename Constraint = CSP_Constraint>
+    void order_values(int level, int variable) {
+        auto& domain = domains[variable];
+        value_scores.clear();
+        for (int x = domain.first(); x != -1; x = domain.next(x)) {
+            int removed = 0;
+            for_each_neighbor(variable, [&](const CSP_Arc& arc, bool forward) {
+                if (assigned[arc.other]) {
+                    return;
                 }
+                auto& other_domain = domains[arc.other];
+                for (int w = other_domain.first(); w != -1; w = other_domain.next(w)) {
+                    removed += !(forward ? check_pair<Constraint>(arc.idx, x, w) : check_pair<Constraint>(arc.idx, w, x));
+                }
+            });
+            value_scores.push_back({removed, x});
+        }
+        std::sort(value_scores.begin(), value_scores.end());
+
+        auto& values = level_values[level];
+        values.clear();
+        for (auto& score : value_scores) {
+            values.push_back(score.second);
+        }
+    }
+
+    // Next value to try at level, among the ones still in domain. -1 when there are none.
+    int next_value(int level, const CSP_Domain& domain) {
+        int x = next_candidate(level, domain);
+        if (breaking_symmetries) {
+            // Values whose image is smaller only lead to solutions whose image is smaller
+            while (x != -1 && !lex_leader(level, x)) {
+                remove_value(order[level], x);
+                x = next_candidate(level, domain);
             }
         }
-        return -1;
+        return x;
     }
 
-    std::vector<int> backtrack_fc() {
-        result.resize(variables.size());
-        
-        std::vector<CSP_Domain> domains;
-        domains.reserve(variables.size());
-        
-        for (int i = 0; i < variables.size(); i++) {
-            domains.push_back(variables[i].get()->domain);
+    int next_candidate(int level, const CSP_Domain& domain) {
+        if (donated[level]) {
+            return -1;
         }
-        
-        int i = 0;
-        while (i >= 0 && i < variables.size()) {
-            int current_value = select_value_fc(variables[i].get(), i);
-            result[i] = current_value;
-            if (current_value == -1) {
-                for (int j = i; j < variables.size(); j++) {
-                    variables[j].get()->domain = domains[j];
+        if (value_ordering == CSP_ValueOrdering::input) {
+            return domain.first();
+        }
+        auto& values = level_values[level];
+        int& k = value_cursor[level];
+        while (k < values.size() && !domain.contains(values[k])) {
+            k++;
+        }
+        return k < values.size() ? values[k] : -1;
+    }
+
+    // Assignment up to level, with x at level, can still be the smallest of its images
+    bool lex_leader(int level, int x) const {
+        int n_symmetries = value_symmetries.size();
+        for (int s = 0; s < n_symmetries; s++) {
+            if (symmetry_tied[level*n_symmetries + s] && value_symmetries[s][x] < x) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Search reaches level i, which picks its variable unless one is forced
+    template <typename Constraint = CSP_Constraint>
+    void enter_level(int i, int forced_variable = -1) {
+        level_marks[i] = trail.size();
+        value_marks[i] = trail.size();
+        if (i == model_variables.size()) {
+            return;
+        }
+        int variable = forced_variable == -1 ? select_variable(i) : forced_variable;
+        order[i] = variable;
+        level_of[variable] = i;
+        assign(variable);
+        result[variable] = -1;
+        value_cursor[i] = 0;
+        donated[i] = 0;
+        if (breaking_symmetries && i > 0) {
+            int n_symmetries = value_symmetries.size();
+            int above = result[order[i-1]];
+            for (int s = 0; s < n_symmetries; s++) {
+                symmetry_tied[i*n_symmetries + s] = symmetry_tied[(i-1)*n_symmetries + s] && value_symmetries[s][above] == above;
+            }
+        }
+        if (value_ordering == CSP_ValueOrdering::lcv) {
+            order_values<Constraint>(i, variable);
+        }
+    }
+
+    // Search backtracks out of level i, after undoing what happened there
+    void leave_level(int i) {
+        level_of[order[i]] = -1;
+        unassign(order[i]);
+    }
+
+    // First constraint of variable whose variables are all assigned that fails with variable assigned x, -1 when they
+    // all hold.
+    // note: With input ordering, inputs of a constraint are assumed to come before its outputs in CSP::variables.
+    template <typename Constraint = CSP_Constraint>
+    int find_conflict(int variable, int x) {
+        int to_offset = graph.to_offsets[variable];
+        int arcs_end = graph.arc_offsets[variable + 1];
+        if (variable_ordering == CSP_VariableOrdering::input) {
+            for (int a = to_offset; a < arcs_end; a++) {
+                if (!csp_consistent<Constraint>(graph.arcs[a].constraint, assignment(), x)) {
+                    return graph.arcs[a].idx;
                 }
-                i = i-1;
             }
-            else {
-                i = i+1;
+            return -1;
+        }
+        for (int a = to_offset; a < arcs_end; a++) {
+            auto& arc = graph.arcs[a];
+            bool ready = arc.other != -1 ? result[arc.other] != -1 : inputs_assigned(arc.idx);
+            if (ready && !csp_consistent<Constraint>(arc.constraint, assignment(), x)) {
+                return arc.idx;
             }
         }
-        if (i == -1) {
-            return {};
-        } else {
-            return result;
+        for (int a = graph.arc_offsets[variable]; a < to_offset; a++) {
+            auto& arc = graph.arcs[a];
+            if (arc.other != -1) {
+                // The input of a binary constraint is variable itself
+                int output = result[arc.other];
+                if (output != -1 && !csp_consistent<Constraint>(arc.constraint, assignment(), output)) {
+                    return arc.idx;
+                }
+                continue;
+            }
+            if (!inputs_assigned(arc.idx)) {
+                continue;
+            }
+            for (int k = graph.output_offsets[arc.idx]; k < graph.scope_offsets[arc.idx + 1]; k++) {
+                int output = result[graph.scope[k]];
+                if (output != -1 && !csp_consistent<Constraint>(arc.constraint, assignment(), output)) {
+                    return arc.idx;
+                }
+            }
+        }
+        return -1;
+    }
+
+    // Global constraint of variable that its assigned variables violate, nullptr when there is none
+    CSP_GlobalConstraint* find_global_conflict(int variable) {
+        for (int k = graph.global_offsets[variable]; k < graph.global_offsets[variable + 1]; k++) {
+            auto global = model_globals[graph.globals[k]];
+            if (!global->check(*this)) {
+                return global;
+            }
+        }
+        return nullptr;
+    }
+
+    template <typename Constraint = CSP_Constraint>
+    bool consistent_with_past(int variable, int x) {
+        return find_conflict<Constraint>(variable, x) == -1 && find_global_conflict(variable) == nullptr;
+    }
+
+    void enqueue_globals(int variable, int skip_global = -1) {
+        for (int k = graph.global_offsets[variable]; k < graph.global_offsets[variable + 1]; k++) {
+            int g = graph.globals[k];
+            if (!global_queued[g] && g != skip_global) {
+                global_queued[g] = 1;
+                global_queue.push_back(g);
+            }
+        }
+    }
+
+    void clear_queues() {
+        for (int g : global_queue) {
+            global_queued[g] = 0;
+        }
+        global_queue.clear();
+        for (int arc : arc_queue) {
+            arc_queued[arc] = 0;
+        }
+        arc_queue.clear();
+    }
+
+    // Propagates the next queued global constraint. What it removes queues the global constraints of the variables
+    // it touched, and their arcs with MAC. Returns false on failure, with the queues cleared.
+    bool propagate_next_global() {
+        int g = global_queue.back();
+        global_queue.pop_back();
+        global_queued[g] = 0;
+        int mark = trail.size();
+        if (!model_globals[g]->propagate(*this)) {
+            clear_queues();
+            return false;
+        }
+        for (int t = mark; t < trail.size(); t++) {
+            int variable = trail[t].variable;
+            if (variable < 0) {
+                continue;
+            }
+            if (propagating_arcs) {
+                enqueue_neighbors(variable, -1, g);
+            } else {
+                enqueue_globals(variable, g);
+            }
+        }
+        return true;
+    }
+
+    // Global constraints of variable, then those of the variables they touch, until nothing changes
+    bool propagate_globals(int variable) {
+        enqueue_globals(variable);
+        while (!global_queue.empty()) {
+            if (!propagate_next_global()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Removes the values of output that the constraint of arc rejects, false when its domain wipes out
+    template <typename Constraint = CSP_Constraint>
+    bool prune_output(const CSP_Arc& arc, int output) {
+        auto& output_domain = domains[output];
+        for (int d = output_domain.first(); d != -1; d = output_domain.next(d)) {
+            if (!csp_consistent<Constraint>(arc.constraint, assignment(), d)) {
+                remove_value(output, d);
+            }
+        }
+        // No more domain : value is rejected
+        if (output_domain.empty()) {
+            bump_weight(arc.idx);
+            return false;
+        }
+        return true;
+    }
+
+    // Removes the values of unassigned variables that conflict with the assignment of variable.
+    // Returns false when a domain wipes out.
+    template <typename Constraint = CSP_Constraint>
+    bool forward_check(int variable) {
+        bool input_ordering = variable_ordering == CSP_VariableOrdering::input;
+        int to_offset = graph.to_offsets[variable];
+        for (int a = graph.arc_offsets[variable]; a < to_offset; a++) {
+            auto& arc = graph.arcs[a];
+            if (arc.other != -1) {
+                // The input of a binary constraint is variable itself
+                if ((input_ordering || result[arc.other] == -1) && !prune_output<Constraint>(arc, arc.other)) {
+                    return false;
+                }
+                continue;
+            }
+            // Other inputs may come later, even with input ordering
+            if (!inputs_assigned(arc.idx)) {
+                continue;
+            }
+            for (int k = graph.output_offsets[arc.idx]; k < graph.scope_offsets[arc.idx + 1]; k++) {
+                int output = graph.scope[k];
+                if ((input_ordering || result[output] == -1) && !prune_output<Constraint>(arc, output)) {
+                    return false;
+                }
+            }
+        }
+
+        // With dynamic orderings, the input of a binary constraint may come after its output
+        if (input_ordering) {
+            return true;
+        }
+        int x = result[variable];
+        for (int a = to_offset; a < graph.arc_offsets[variable + 1]; a++) {
+            auto& arc = graph.arcs[a];
+            if (arc.other == -1 || result[arc.other] != -1) {
+                continue;
+            }
+            auto& input_domain = domains[arc.other];
+            for (int d = input_domain.first(); d != -1; d = input_domain.next(d)) {
+                if (!check_pair<Constraint>(arc.idx, d, x)) {
+                    remove_value(arc.other, d);
+                }
+            }
+            if (input_domain.empty()) {
+                bump_weight(arc.idx);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename Constraint = CSP_Constraint>
+    int select_value(int current_variable_idx, int level) {
+        auto& domain = domains[current_variable_idx];
+        for (int x = next_value(level, domain); x != -1; x = next_value(level, domain)) {
+            remove_value(current_variable_idx, x);
+            value_marks[level] = trail.size();
+            result[current_variable_idx] = x;
+
+            if (consistent_with_past<Constraint>(current_variable_idx, x)) {
+                return x;
+            }
+        }
+        return -1;
+    }
+    
+    template <typename Constraint = CSP_Constraint>
+    int select_value_fc(int current_variable_idx, int level) {
+        // Removals caused by the previous value of this variable
+        undo_to(value_marks[level]);
+
+        auto& domain = domains[current_variable_idx];
+        for (int x = next_value(level, domain); x != -1; x = next_value(level, domain)) {
+            remove_value(current_variable_idx, x);
+            value_marks[level] = trail.size();
+            result[current_variable_idx] = x;
+
+            // Variable is consistent with past choices, and with future variables (no future variable has
+            // empty domain) -- Forward Checking
+            if (consistent_with_past<Constraint>(current_variable_idx, x) && forward_check<Constraint>(current_variable_idx) && propagate_globals(current_variable_idx)) {
+                return x;
+            }
+            // Only what x removed comes back
+            undo_to(value_marks[level]);
+        }
+        return -1;
+    }
+
+    void start_propagation() {
+        propagating_arcs = true;
+        int n_arcs = 2*model_constraints.size();
+        arc_queue.clear();
+        arc_queued.assign(n_arcs, 0);
+        residue_offsets.assign(n_arcs + 1, 0);
+        for (int a = 0; a < n_arcs; a++) {
+            int revised = revised_variable(a);
+            residue_offsets[a + 1] = residue_offsets[a] + (revised == -1 ? 0 : domains[revised].capacity);
+        }
+        residues.assign(residue_offsets[n_arcs], -1);
+    }
+
+    // Variable whose values arc revises, -1 when its constraint is not binary
+    int revised_variable(int arc) const {
+        return arc % 2 == 0 ? graph.binary_output[arc/2] : graph.binary_input[arc/2];
+    }
+
+    void enqueue_arc(int arc) {
+        if (!arc_queued[arc]) {
+            arc_queued[arc] = 1;
+            arc_queue.push_back(arc);
+        }
+    }
+
+    // Arcs revising the neighbors of variable and its global constraints, except skip_constraint and skip_global
+    void enqueue_neighbors(int variable, int skip_constraint = -1, int skip_global = -1) {
+        int to_offset = graph.to_offsets[variable];
+        for (int a = graph.arc_offsets[variable]; a < graph.arc_offsets[variable + 1]; a++) {
+            auto& arc = graph.arcs[a];
+            if (arc.other != -1 && arc.idx != skip_constraint) {
+                enqueue_arc(2*arc.idx + (a >= to_offset));
+            }
+        }
+        enqueue_globals(variable, skip_global);
+    }
+
+    template <typename Constraint = CSP_Constraint>
+    bool check_pair(int constraint, int input_value, int output_value) {
+        int input_idx = graph.binary_input[constraint];
+        arc_assignment[input_idx] = input_value;
+        bool consistent = csp_consistent<Constraint>(model_constraints[constraint], {arc_assignment.data(), (int)arc_assignment.size()}, output_value);
+        arc_assignment[input_idx] = -1;
+        return consistent;
+    }
+
+    // Removes the values of the revised variable without support, returns true when some were removed
+    template <typename Constraint = CSP_Constraint>
+    bool revise(int arc) {
+        int constraint = arc/2;
+        bool forward = arc % 2 == 0;
+        int revised = forward ? graph.binary_output[constraint] : graph.binary_input[constraint];
+        int other = forward ? graph.binary_input[constraint] : graph.binary_output[constraint];
+        auto& revised_domain = domains[revised];
+        auto& other_domain = domains[other];
+        int* arc_residues = &residues[residue_offsets[arc]];
+
+        bool changed = false;
+        for (int v = revised_domain.first(); v != -1; v = revised_domain.next(v)) {
+            // With ac2001, the search resumes after the last support and wraps around: values before it were not
+            // supports when it was found, but backtracking may have brought some back since.
+            int last = propagation == CSP_Propagation::ac2001 ? arc_residues[v] : -1;
+            if (last != -1 && other_domain.contains(last)) {
+                continue;
+            }
+            auto supports = [&](int w) {
+                return forward ? check_pair<Constraint>(constraint, w, v) : check_pair<Constraint>(constraint, v, w);
+            };
+            int w = other_domain.next(last);
+            while (w != -1 && !supports(w)) {
+                w = other_domain.next(w);
+            }
+            if (w == -1 && last != -1) {
+                w = other_domain.first();
+                while (w != -1 && w < last && !supports(w)) {
+                    w = other_domain.next(w);
+                }
+                w = w < last ? w : -1;
+            }
+            if (w != -1) {
+                arc_residues[v] = w;
+            } else {
+                remove_value(revised, v);
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    // Runs queued arcs until the queue is empty (arc consistent) or a domain wipes out (returns false). Queued global
+    // constraints run once no arc is left, each one possibly queueing more arcs.
+    template <typename Constraint = CSP_Constraint>
+    bool propagate() {
+        while (true) {
+            if (!propagate_arcs<Constraint>()) {
+                return false;
+            }
+            if (global_queue.empty()) {
+                return true;
+            }
+            if (!propagate_next_global()) {
+                return false;
+            }
+        }
+    }
+
+    template <typename Constraint = CSP_Constraint>
+    bool propagate_arcs() {
+        for (int head = 0; head < arc_queue.size(); head++) {
+            int arc = arc_queue[head];
+            arc_queued[arc] = 0;
+            if (revise<Constraint>(arc)) {
+                int revised = revised_variable(arc);
+                if (domains[revised].empty()) {
+                    bump_weight(arc/2);
+                    clear_queues();
+                    return false;
+                }
+                enqueue_neighbors(revised, arc/2);
+            }
+        }
+        arc_queue.clear();
+        return true;
+    }
+
+    template <typename Constraint = CSP_Constraint>
+    bool propagate_all() {
+        for (int c = 0; c < model_constraints.size(); c++) {
+            if (is_binary(c)) {
+                enqueue_arc(2*c);
+                enqueue_arc(2*c + 1);
+            }
+        }
+        for (int g = 0; g < model_globals.size(); g++) {
+            global_queued[g] = 1;
+            global_queue.push_back(g);
+        }
+        return propagate<Constraint>();
+    }
+
+    // Preprocessing: prunes the domains of the variables to arc consistency. Returns false when a domain wipes out,
+    // in which case the problem has no solution.
+    template <typename Constraint = CSP_Constraint>
+    bool arc_consistency() {
+        start_search();
+        start_propagation();
+        bool consistent = propagate_all<Constraint>();
+        for (int i = 0; i < model_variables.size(); i++) {
+            model_variables[i]->domain = domains[i];
+        }
+        trail.clear();
+        saved_words.clear();
+        return consistent;
+    }
+
+    // Maintaining arc consistency: the domain of the variable is reduced to its value and propagated. A value that
+    // fails is removed and that removal is propagated too, before trying the next one.
+    template <typename Constraint = CSP_Constraint>
+    int select_value_mac(int current_variable_idx, int level) {
+        // Assignment of the previous value and what it propagated
+        undo_to(value_marks[level]);
+
+        auto& domain = domains[current_variable_idx];
+        if (result[current_variable_idx] != -1) {
+            // Back from a dead end below: the previous value is refuted
+            remove_value(current_variable_idx, result[current_variable_idx]);
+            result[current_variable_idx] = -1;
+            enqueue_neighbors(current_variable_idx);
+            if (domain.empty() || !propagate<Constraint>()) {
+                return -1;
+            }
+        }
+
+        for (int x = next_value(level, domain); x != -1; x = next_value(level, domain)) {
+            value_marks[level] = trail.size();
+            result[current_variable_idx] = x;
+
+            if (consistent_with_past<Constraint>(current_variable_idx, x)) {
+                for (int v = domain.first(); v != -1; v = domain.next(v)) {
+                    if (v != x) {
+                        remove_value(current_variable_idx, v);
+                    }
+                }
+                enqueue_neighbors(current_variable_idx);
+                if (propagate<Constraint>()) {
+                    return x;
+                }
+            }
+
+            undo_to(value_marks[level]);
+            remove_value(current_variable_idx, x);
+            result[current_variable_idx] = -1;
+            enqueue_neighbors(current_variable_idx);
+            if (domain.empty() || !propagate<Constraint>()) {
+                return -1;
+            }
+        }
+        return -1;
+    }
+
+    void start_backjumping() {
+        int n_variables = model_variables.size();
+        conflict_sets.assign(n_variables + 1, CSP_Domain(n_variables));
+        nogoods.clear();
+        oldest_nogood = 0;
+        watch_offsets.assign(n_variables + 1, 0);
+        for (int i = 0; i < n_variables; i++) {
+            watch_offsets[i + 1] = watch_offsets[i] + domains[i].capacity;
+        }
+        watch_lists.assign(watch_offsets[n_variables], {});
+    }
+
+    bool holds(const CSP_Literal& literal) const {
+        return result[literal.variable] == literal.value;
+    }
+
+    std::vector<int>& watchers(const CSP_Literal& literal) {
+        return watch_lists[watch_offsets[literal.variable] + literal.value];
+    }
+
+    void unwatch(int nogood_idx) {
+        auto& nogood = nogoods[nogood_idx];
+        for (int side = 0; side < 2; side++) {
+            auto& list = watchers(nogood.literals[nogood.watched[side]]);
+            for (int w = 0; w < list.size(); w++) {
+                if (list[w] == nogood_idx) {
+                    list[w] = list.back();
+                    list.pop_back();
+                    break;
+                }
+            }
+        }
+    }
+
+    // The assignment of the levels is recorded as a nogood, replacing the oldest one when the store is full
+    void record_nogood(const CSP_Domain& levels) {
+        CSP_Nogood nogood;
+        for (int l = levels.first(); l != -1; l = levels.next(l)) {
+            nogood.literals.push_back({order[l], result[order[l]]});
+        }
+        // Watches on the two deepest levels: the backjump undoes the deepest one and the other one stays until the
+        // search leaves its level, so at most one of them starts to hold before the nogood is checked
+        int n_literals = nogood.literals.size();
+        nogood.watched[0] = n_literals - 1;
+        nogood.watched[1] = n_literals >= 2 ? n_literals - 2 : n_literals - 1;
+
+        int nogood_idx = nogoods.size();
+        if (nogoods.size() < nogood_capacity) {
+            nogoods.push_back(std::move(nogood));
+        } else {
+            nogood_idx = oldest_nogood;
+            oldest_nogood = (oldest_nogood + 1) % nogood_capacity;
+            unwatch(nogood_idx);
+            nogoods[nogood_idx] = std::move(nogood);
+        }
+        auto& stored = nogoods[nogood_idx];
+        watchers(stored.literals[stored.watched[0]]).push_back(nogood_idx);
+        if (stored.watched[1] != stored.watched[0]) {
+            watchers(stored.literals[stored.watched[1]]).push_back(nogood_idx);
+        }
+    }
+
+    // Nogood violated now that variable is assigned x, -1 if there is none. Only nogoods watching variable = x are
+    // visited, each one moves that watch to a literal that does not hold if it has one.
+    // note: Nothing is done when backtracking, literals that stop holding keep their watches valid.
+    int find_nogood(int variable, int x) {
+        auto& list = watch_lists[watch_offsets[variable] + x];
+        for (int w = 0; w < list.size();) {
+            int nogood_idx = list[w];
+            auto& nogood = nogoods[nogood_idx];
+            int side = nogood.literals[nogood.watched[0]].variable == variable ? 0 : 1;
+
+            int replacement = -1;
+            for (int l = 0; l < nogood.literals.size(); l++) {
+                if (l != nogood.watched[0] && l != nogood.watched[1] && !holds(nogood.literals[l])) {
+                    replacement = l;
+                    break;
+                }
+            }
+            if (replacement != -1) {
+                nogood.watched[side] = replacement;
+                watchers(nogood.literals[replacement]).push_back(nogood_idx);
+                list[w] = list.back();
+                list.pop_back();
+                continue;
+            }
+            if (holds(nogood.literals[nogood.watched[1 - side]])) {
+                return nogood_idx;
+            }
+            w++;
+        }
+        return -1;
+    }
+
+    // Levels of the assigned variables of vars other than variable
+    void add_conflict(CSP_Domain& conflicts, const std::vector<CSP_Variable*>& vars, int variable) {
+        for (auto var : vars) {
+            if (var->idx != variable && level_of[var->idx] != -1) {
+                conflicts.insert(level_of[var->idx]);
+            }
+        }
+    }
+
+    // Same for the variables of constraint
+    void add_conflict(CSP_Domain& conflicts, int constraint, int variable) {
+        for (int k = graph.scope_offsets[constraint]; k < graph.scope_offsets[constraint + 1]; k++) {
+            int other = graph.scope[k];
+            if (other != variable && level_of[other] != -1) {
+                conflicts.insert(level_of[other]);
+            }
+        }
+    }
+
+    template <typename Constraint = CSP_Constraint>
+    int select_value_cbj(int current_variable_idx, int level) {
+        auto& domain = domains[current_variable_idx];
+        auto& conflicts = conflict_sets[level];
+        for (int x = next_value(level, domain); x != -1; x = next_value(level, domain)) {
+            remove_value(current_variable_idx, x);
+            result[current_variable_idx] = x;
+
+            int constraint = find_conflict<Constraint>(current_variable_idx, x);
+            if (constraint != -1) {
+                add_conflict(conflicts, constraint, current_variable_idx);
+                continue;
+            }
+            if (auto global = find_global_conflict(current_variable_idx)) {
+                add_conflict(conflicts, global->scope, current_variable_idx);
+                continue;
+            }
+            int nogood_idx = nogoods.empty() ? -1 : find_nogood(current_variable_idx, x);
+            if (nogood_idx != -1) {
+                for (auto& literal : nogoods[nogood_idx].literals) {
+                    if (literal.variable != current_variable_idx) {
+                        conflicts.insert(level_of[literal.variable]);
+                    }
+                }
+                continue;
+            }
+            return x;
+        }
+        return -1;
+    }
+
+    // Conflict-directed backjumping: every value rejected at a level adds the levels it conflicted with to the
+    // conflict set of that level. A dead end jumps back to the deepest level of its conflict set, which inherits the
+    // rest of the set, instead of stepping back one level. With nogood_capacity > 0, the assignment of the levels of
+    // the conflict set is also recorded as a nogood, so that it is rejected without search when it comes back.
+    // note: Plain consistency checking only, pruning by forward checking or MAC would need its own explanations.
+    template <typename Constraint = CSP_Constraint>
+    std::vector<int> backtrack_cbj(SearchControl* control = nullptr) {
+        TRACE_ZONE("CSP search CBJ");
+        if (control) {
+            control->start();
+        }
+        start_search();
+        start_backjumping();
+        enter_level<Constraint>(0);
+
+        int i = 0;
+        while (i >= 0 && i < model_variables.size()) {
+            if (control && !control->poll(i)) {
+                undo_to(0);
+                return {};
+            }
+            int current_value = select_value_cbj<Constraint>(order[i], i);
+            result[order[i]] = current_value;
+            if (current_value != -1) {
+                i = i+1;
+                enter_level<Constraint>(i);
+                conflict_sets[i].clear();
+                continue;
+            }
+
+            auto& conflicts = conflict_sets[i];
+            int jump = conflicts.last();
+            if (nogood_capacity > 0 && jump != -1 && conflicts.size() <= max_nogood_size) {
+                record_nogood(conflicts);
+            }
+            // Levels after the jump did not cause the dead end, everything they did is undone
+            for (int k = i; k > jump; k--) {
+                undo_to(level_marks[k]);
+                result[order[k]] = -1;
+                leave_level(k);
+            }
+            if (jump != -1) {
+                conflicts.erase(jump);
+                for (int l = conflicts.first(); l != -1; l = conflicts.next(l)) {
+                    conflict_sets[jump].insert(l);
+                }
+            }
+            i = jump;
+        }
+        undo_to(0);
+        if (control) {
+            control->finish();
+        }
+        if (i == -1) {
+            return {};
+        } else {
+            return result;
+        }
+    }
+
+    template <typename Constraint = CSP_Constraint>
+    int select_level_value(CSP_Inference inference, int level) {
+        int variable = order[level];
+        if (inference == CSP_Inference::none) {
+            return select_value<Constraint>(variable, level);
+        } else if (inference == CSP_Inference::forward_checking) {
+            return select_value_fc<Constraint>(variable, level);
+        }
+        return select_value_mac<Constraint>(variable, level);
+    }
+
+    // Depth first search over levels from level i, each level assigning the variable picked by variable_ordering.
+    // Returns true on a solution, false once the search backtracks above level 0 or when poll(level), called before
+    // every value selection, returns false.
+    template <typename Constraint = CSP_Constraint, typename Poll>
+    bool run_levels(CSP_Inference inference, int i, Poll poll) {
+        while (i >= 0 && i < model_variables.size()) {
+            if (!poll(i)) {
+                return false;
+            }
+            int current_value = select_level_value<Constraint>(inference, i);
+            result[order[i]] = current_value;
+            if (current_value == -1) {
+                // Values tried at level i come back, the ones tried at i-1 stay out
+                undo_to(level_marks[i]);
+                leave_level(i);
+                i = i-1;
+            }
+            else {
+                i = i+1;
+                enter_level<Constraint>(i);
+            }
+        }
+        return i >= 0;
+    }
+
+    // Search state at level 0, false when MAC finds the problem inconsistent before any assignment
+    template <typename Constraint = CSP_Constraint>
+    bool start_levels(CSP_Inference inference) {
+        start_search();
+        if (inference == CSP_Inference::mac) {
+            TRACE_ZONE("CSP initial propagation");
+            start_propagation();
+            if (!propagate_all<Constraint>()) {
+                undo_to(0);
+                return false;
+            }
+        }
+        enter_level<Constraint>(0);
+        return true;
+    }
+
+    // With a control, the search returns no solution once it runs out of time or nodes or is cancelled, see
+    // control->status. The bound it reports is the deepest level reached.
+    template <typename Constraint = CSP_Constraint>
+    std::vector<int> search(CSP_Inference inference, SearchControl* control = nullptr) {
+        TRACE_ZONE("CSP search");
+        if (control) {
+            control->start();
+        }
+        if (!start_levels<Constraint>(inference)) {
+            if (control) {
+                control->finish();
+            }
+            return {};
+        }
+        bool found = run_levels<Constraint>(inference, 0, [&](int i) { return !control || control->poll(i); });
+        undo_to(0);
+        if (control) {
+            control->finish();
+        }
+        if (!found) {
+            return {};
+        } else {
+            return result;
+        }
+    }
+
+    // Number of distinct images of the current (complete) assignment under the value symmetries, itself included
+    int orbit_size() {
+        int n_variables = model_variables.size();
+        std::vector<std::vector<int>> images = {result};
+        for (auto& symmetry : value_symmetries) {
+            std::vector<int> image(n_variables);
+            for (int i = 0; i < n_variables; i++) {
+                image[i] = symmetry[result[i]];
+            }
+            if (std::find(images.begin(), images.end(), image) == images.end()) {
+                images.push_back(std::move(image));
+            }
+        }
+        return images.size();
+    }
+
+    // Streams the solutions to on_solution(solution, orbit_size) without storing them, until it returns false.
+    // Without value symmetries every solution is visited with orbit_size 1. With them, only the lexicographically
+    // smallest solution of each orbit is, orbit_size counting the solutions it stands for. Returns the number of
+    // solutions visited, orbits counted in full.
+    // note: solution is only valid during the call. Symmetry breaking needs input variable ordering. A control stops the
+    // enumeration like it stops search(), the solutions visited until then are counted.
+    template <typename Constraint = CSP_Constraint, typename Callback>
+    long long enumerate_solutions(CSP_Inference inference, Callback on_solution, SearchControl* control = nullptr) {
+        TRACE_ZONE("CSP enumerate solutions");
+        if (!value_symmetries.empty() && variable_ordering != CSP_VariableOrdering::input) {
+            std::cerr << "Error : Value symmetries need input variable ordering" << std::endl;
+            return 0;
+        }
+        breaking_symmetries = !value_symmetries.empty();
+        if (control) {
+            control->start();
+        }
+
+        long long n_solutions = 0;
+        if (start_levels<Constraint>(inference)) {
+            int n_variables = model_variables.size();
+            int i = 0;
+            while (run_levels<Constraint>(inference, i, [&](int level) { return !control || control->poll(level); })) {
+                int n_images = breaking_symmetries ? orbit_size() : 1;
+                n_solutions += n_images;
+                if (!on_solution(assignment(), n_images)) {
+                    break;
+                }
+                // Next value of the last level
+                i = n_variables - 1;
+                if (i < 0) {
+                    break;
+                }
+            }
+        }
+        undo_to(0);
+        breaking_symmetries = false;
+        if (control) {
+            control->finish();
+        }
+        return n_solutions;
+    }
+
+    template <typename Constraint = CSP_Constraint>
+    long long count_solutions(CSP_Inference inference = CSP_Inference::forward_checking, SearchControl* control = nullptr) {
+        return enumerate_solutions<Constraint>(inference, [](CSP_Assignment, int) { return true; }, control);
+    }
+
+    // Values not tried yet at level: those its variable had when the current value was picked, minus that value
+    CSP_Domain untried_values(int level) {
+        int variable = order[level];
+        CSP_Domain values = domains[variable];
+        for (int t = value_marks[level]; t < trail.size(); t++) {
+            if (trail[t].variable == variable) {
+                values.insert(trail[t].value);
+            }
+        }
+        if (result[variable] != -1) {
+            values.erase(result[variable]);
+        }
+        return values;
+    }
+
+    // Hands the untried values of the shallowest open level above level over to subtree. The search then skips them.
+    bool donate(int level, CSP_Subtree& subtree) {
+        for (int k = 0; k < level; k++) {
+            if (donated[k]) {
+                continue;
+            }
+            CSP_Domain values = untried_values(k);
+            if (values.empty()) {
+                continue;
+            }
+            subtree.path.clear();
+            for (int j = 0; j < k; j++) {
+                subtree.path.push_back({order[j], result[order[j]]});
+            }
+            subtree.variable = order[k];
+            subtree.values = std::move(values);
+            donated[k] = 1;
+            return true;
+        }
+        return false;
+    }
+
+    // Leaves only values in the domain of the variable of level, the search does not try the others
+    void restrict_level(int level, const CSP_Domain& values) {
+        int variable = order[level];
+        auto& domain = domains[variable];
+        for (int x = domain.first(); x != -1; x = domain.next(x)) {
+            if (!values.contains(x)) {
+                remove_value(variable, x);
+            }
+        }
+        value_marks[level] = trail.size();
+    }
+
+    // Search state at the root of subtree: its path is assigned level by level, with the same inference as the
+    // search, and its first level only has the values of the subtree. Returns that level, -1 when the path fails.
+    template <typename Constraint = CSP_Constraint>
+    int enter_subtree(const CSP_Subtree& subtree, CSP_Inference inference) {
+        start_search();
+        if (inference == CSP_Inference::mac) {
+            start_propagation();
+            if (!propagate_all<Constraint>()) {
+                return -1;
+            }
+        }
+        int n_path = subtree.path.size();
+        for (int j = 0; j < n_path; j++) {
+            auto& literal = subtree.path[j];
+            enter_level<Constraint>(j, literal.variable);
+            CSP_Domain value(domains[literal.variable].capacity);
+            value.insert(literal.value);
+            restrict_level(j, value);
+            if (select_level_value<Constraint>(inference, j) != literal.value) {
+                return -1;
+            }
+            result[literal.variable] = literal.value;
+        }
+        enter_level<Constraint>(n_path, subtree.variable);
+        if (subtree.variable != -1) {
+            restrict_level(n_path, subtree.values);
+            if (inference == CSP_Inference::mac) {
+                enqueue_neighbors(subtree.variable);
+                if (domains[subtree.variable].empty() || !propagate<Constraint>()) {
+                    return -1;
+                }
+                value_marks[n_path] = trail.size();
+            }
+        }
+        return n_path;
+    }
+
+    template <typename Constraint = CSP_Constraint>
+    std::vector<int> backtrack(SearchControl* control = nullptr) {
+        return search<Constraint>(CSP_Inference::none, control);
+    }
+
+    template <typename Constraint = CSP_Constraint>
+    std::vector<int> backtrack_fc(SearchControl* control = nullptr) {
+        return search<Constraint>(CSP_Inference::forward_checking, control);
+    }
+
+    template <typename Constraint = CSP_Constraint>
+    std::vector<int> backtrack_mac(SearchControl* control = nullptr) {
+        return search<Constraint>(CSP_Inference::mac, control);
+    }
+};
+
+// Values an assigned variable counts as having in global constraints
+inline int csp_first_value(const CSP& csp, int variable) {
+    return csp.result[variable] != -1 ? csp.result[variable] : csp.domains[variable].first();
+}
+
+inline int csp_last_value(const CSP& csp, int variable) {
+    return csp.result[variable] != -1 ? csp.result[variable] : csp.domains[variable].last();
+}
+
+inline int csp_next_value(const CSP& csp, int variable, int after) {
+    return csp.result[variable] != -1 ? (after < csp.result[variable] ? csp.result[variable] : -1) : csp.domains[variable].next(after);
+}
+
+// Variables of scope, each shifted by its offset, take pairwise different values. Propagated to generalized arc
+// consistency with Régin's algorithm: a value is kept when some maximum matching of variables to values uses it,
+// which one matching and the strongly connected components of its residual graph tell.
+// note: Offsets give the diagonals of N-Queens, x_i + i and x_i - i all different.
+struct CSP_AllDifferent : CSP_GlobalConstraint {
+    std::vector<int> offsets;
+
+    CSP_AllDifferent(std::vector<CSP_Variable*> new_scope, std::vector<int> new_offsets = {}) {
+        scope = std::move(new_scope);
+        offsets = new_offsets.empty() ? std::vector<int>(scope.size(), 0) : std::move(new_offsets);
+        for (auto var : scope) {
+            var->globals.push_back(this);
+        }
+    }
+
+    bool check(const CSP& csp) override {
+        auto& values = scratch().values;
+        values.clear();
+        for (int i = 0; i < scope.size(); i++) {
+            int x = csp.result[scope[i]->idx];
+            if (x != -1) {
+                values.push_back(x + offsets[i]);
+            }
+        }
+        std::sort(values.begin(), values.end());
+        return std::adjacent_find(values.begin(), values.end()) == values.end();
+    }
+
+    bool propagate(CSP& csp) override {
+        auto& s = scratch();
+        int n_vars = scope.size();
+
+        // Value nodes are shifted values minus the smallest one
+        int low = 0;
+        int high = -1;
+        for (int i = 0; i < n_vars; i++) {
+            int first = csp_first_value(csp, scope[i]->idx);
+            if (first == -1) {
+                return false;
+            }
+            int last = csp_last_value(csp, scope[i]->idx);
+            low = i == 0 || first + offsets[i] < low ? first + offsets[i] : low;
+            high = i == 0 || last + offsets[i] > high ? last + offsets[i] : high;
+        }
+        int n_values = high - low + 1;
+        if (n_values < n_vars) {
+            return false;
+        }
+
+        // Edges from variables to values, then from values to variables
+        s.var_offsets.assign(n_vars + 1, 0);
+        s.var_edges.clear();
+        s.value_offsets.assign(n_values + 1, 0);
+        for (int i = 0; i < n_vars; i++) {
+            int var = scope[i]->idx;
+            for (int x = csp_first_value(csp, var); x != -1; x = csp_next_value(csp, var, x)) {
+                s.var_edges.push_back(x + offsets[i] - low);
+                s.value_offsets[x + offsets[i] - low + 1]++;
+            }
+            s.var_offsets[i + 1] = s.var_edges.size();
+        }
+        for (int v = 0; v < n_values; v++) {
+            s.value_offsets[v + 1] += s.value_offsets[v];
+        }
+        s.value_edges.resize(s.var_edges.size());
+        s.fill.assign(s.value_offsets.begin(), s.value_offsets.end() - 1);
+        for (int i = 0; i < n_vars; i++) {
+            for (int e = s.var_offsets[i]; e < s.var_offsets[i + 1]; e++) {
+                s.value_edges[s.fill[s.var_edges[e]]++] = i;
+            }
+        }
+
+        if (!maximum_matching(s, n_vars, n_values)) {
+            return false;
+        }
+
+        // Residual graph: variable -> its matched value, value -> the other variables having it. Nodes are variables
+        // then values. Values reachable from a free value lie on an even alternating path, so are kept.
+        s.reached.assign(n_values, 0);
+        s.stack.clear();
+        for (int v = 0; v < n_values; v++) {
+            if (s.value_match[v] == -1 && s.value_offsets[v + 1] > s.value_offsets[v]) {
+                s.reached[v] = 1;
+                s.stack.push_back(v);
+            }
+        }
+        while (!s.stack.empty()) {
+            int v = s.stack.back();
+            s.stack.pop_back();
+            for (int e = s.value_offsets[v]; e < s.value_offsets[v + 1]; e++) {
+                int next = s.var_match[s.value_edges[e]];
+                if (next != v && !s.reached[next]) {
+                    s.reached[next] = 1;
+                    s.stack.push_back(next);
+                }
+            }
+        }
+        strongly_connected_components(s, n_vars, n_values);
+
+        for (int i = 0; i < n_vars; i++) {
+            int var = scope[i]->idx;
+            if (csp.result[var] != -1) {
+                continue;
+            }
+            for (int e = s.var_offsets[i]; e < s.var_offsets[i + 1]; e++) {
+                int v = s.var_edges[e];
+                if (v != s.var_match[i] && !s.reached[v] && s.component[n_vars + v] != s.component[i]) {
+                    csp.remove_value(var, v + low - offsets[i]);
+                }
+            }
+        }
+        return true;
+    }
+
+    private:
+        struct Scratch {
+            std::vector<int> values;
+            std::vector<int> var_offsets, var_edges, value_offsets, value_edges, fill;
+            std::vector<int> var_match, value_match, parent, visited, queue;
+            std::vector<int> reached, stack;
+            std::vector<int> component, index, lowlink, call_stack, edge_stack;
+            std::vector<char> on_stack;
+        };
+
+        // Working memory of the propagator, one per thread since the constraint is shared by parallel workers
+        static Scratch& scratch() {
+            static thread_local Scratch s;
+            return s;
+        }
+
+        // Greedy matching, then one breadth first search for an augmenting path per unmatched variable.
+        // False when some variable stays unmatched.
+        static bool maximum_matching(Scratch& s, int n_vars, int n_values) {
+            s.var_match.assign(n_vars, -1);
+            s.value_match.assign(n_values, -1);
+            for (int i = 0; i < n_vars; i++) {
+                for (int e = s.var_offsets[i]; e < s.var_offsets[i + 1]; e++) {
+                    if (s.value_match[s.var_edges[e]] == -1) {
+                        s.var_match[i] = s.var_edges[e];
+                        s.value_match[s.var_edges[e]] = i;
+                        break;
+                    }
+                }
+            }
+
+            s.parent.assign(n_vars, -1); // Value through which each variable was reached
+            s.visited.assign(n_vars, -1);
+            for (int root = 0; root < n_vars; root++) {
+                if (s.var_match[root] != -1) {
+                    continue;
+                }
+                s.queue.assign(1, root);
+                s.visited[root] = root;
+                int free_value = -1;
+                int last_var = -1;
+                for (int head = 0; head < s.queue.size() && free_value == -1; head++) {
+                    int i = s.queue[head];
+                    for (int e = s.var_offsets[i]; e < s.var_offsets[i + 1]; e++) {
+                        int v = s.var_edges[e];
+                        int j = s.value_match[v];
+                        if (j == -1) {
+                            free_value = v;
+                            last_var = i;
+                            break;
+                        }
+                        if (s.visited[j] != root) {
+                            s.visited[j] = root;
+                            s.parent[j] = i;
+                            s.queue.push_back(j);
+                        }
+                    }
+                }
+                if (free_value == -1) {
+                    return false;
+                }
+                // Flip the path: each variable takes the value its successor had
+                for (int i = last_var, v = free_value; i != -1;) {
+                    int previous_value = s.var_match[i];
+                    s.var_match[i] = v;
+                    s.value_match[v] = i;
+                    v = previous_value;
+                    i = i == root ? -1 : s.parent[i];
+                }
+            }
+            return true;
+        }
+
+        // Tarjan's algorithm without recursion on the residual graph, component of each node in s.component
+        static void strongly_connected_components(Scratch& s, int n_vars, int n_values) {
+            int n_nodes = n_vars + n_values;
+            s.index.assign(n_nodes, -1);
+            s.lowlink.assign(n_nodes, 0);
+            s.component.assign(n_nodes, -1);
+            s.on_stack.assign(n_nodes, 0);
+            s.stack.clear();
+            int counter = 0;
+
+            // Successors of node, k-th one (-1 past the last): a variable has its matched value, a value the variables
+            // it is not matched to
+            auto successor = [&](int node, int k) {
+                if (node < n_vars) {
+                    return k == 0 ? n_vars + s.var_match[node] : -1;
+                }
+                int v = node - n_vars;
+                int e = s.value_offsets[v] + k;
+                if (e >= s.value_offsets[v + 1]) {
+                    return -1;
+                }
+                int i = s.value_edges[e];
+                return i == s.value_match[v] ? -2 : i; // -2: skipped edge
+            };
+
+            for (int start = 0; start < n_nodes; start++) {
+                if (s.index[start] != -1) {
+                    continue;
+                }
+                s.call_stack.assign(1, start);
+                s.edge_stack.assign(1, 0);
+                s.index[start] = s.lowlink[start] = counter++;
+                s.stack.push_back(start);
+                s.on_stack[start] = 1;
+                while (!s.call_stack.empty()) {
+                    int node = s.call_stack.back();
+                    int next = successor(node, s.edge_stack.back()++);
+                    if (next == -2) {
+                        continue;
+                    }
+                    if (next != -1) {
+                        if (s.index[next] == -1) {
+                            s.index[next] = s.lowlink[next] = counter++;
+                            s.stack.push_back(next);
+                            s.on_stack[next] = 1;
+                            s.call_stack.push_back(next);
+                            s.edge_stack.push_back(0);
+                        } else if (s.on_stack[next]) {
+                            s.lowlink[node] = s.index[next] < s.lowlink[node] ? s.index[next] : s.lowlink[node];
+                        }
+                        continue;
+                    }
+                    // All successors done
+                    s.call_stack.pop_back();
+                    s.edge_stack.pop_back();
+                    if (!s.call_stack.empty()) {
+                        int caller = s.call_stack.back();
+                        s.lowlink[caller] = s.lowlink[node] < s.lowlink[caller] ? s.lowlink[node] : s.lowlink[caller];
+                    }
+                    if (s.lowlink[node] == s.index[node]) {
+                        int member;
+                        do {
+                            member = s.stack.back();
+                            s.stack.pop_back();
+                            s.on_stack[member] = 0;
+                            s.component[member] = node;
+                        } while (member != node);
+                    }
+                }
+            }
+        }
+};
+
+// Extensional constraint: the values of scope form one of tuples. Propagated with compact table: a reversible bitset
+// of the tuples still valid, and for each variable and value the bitset of the tuples it supports. A value is removed
+// once none of its tuples is valid.
+struct CSP_Table : CSP_GlobalConstraint {
+    int n_tuples = 0;
+    int n_tuple_words = 0;
+    std::vector<int> support_offsets; // Supports of value x of scope[i] are the n_tuple_words words at supports[(support_offsets[i] + x)*n_tuple_words]
+    std::vector<int> value_capacity;
+    std::vector<uint64_t> supports;
+
+    // Tuple k is tuples[k], one value per variable of scope
+    CSP_Table(std::vector<CSP_Variable*> new_scope, const std::vector<std::vector<int>>& tuples) {
+        scope = std::move(new_scope);
+        int arity = scope.size();
+        n_tuples = tuples.size();
+        n_tuple_words = (n_tuples + 63) / 64;
+        support_offsets.assign(arity + 1, 0);
+        value_capacity.assign(arity, 0);
+        for (int i = 0; i < arity; i++) {
+            value_capacity[i] = scope[i]->domain.capacity;
+            for (auto& tuple : tuples) {
+                value_capacity[i] = tuple[i] + 1 > value_capacity[i] ? tuple[i] + 1 : value_capacity[i];
+            }
+            support_offsets[i + 1] = support_offsets[i] + value_capacity[i];
+        }
+        supports.assign((size_t)support_offsets[arity]*n_tuple_words, 0);
+        for (int k = 0; k < n_tuples; k++) {
+            for (int i = 0; i < arity; i++) {
+                supports[(size_t)(support_offsets[i] + tuples[k][i])*n_tuple_words + k/64] |= 1ull << (k % 64);
+            }
+        }
+        for (auto var : scope) {
+            var->globals.push_back(this);
+        }
+    }
+
+    // Valid tuples, then the domain size of each variable when the tuples were last updated
+    int n_words() const override { return n_tuple_words + scope.size(); }
+
+    void start(CSP& csp) override {
+        for (int w = 0; w < n_tuple_words; w++) {
+            csp.global_words[word_offset + w] = ~0ull;
+        }
+        if (n_tuples & 63) {
+            csp.global_words[word_offset + n_tuple_words - 1] = (1ull << (n_tuples & 63)) - 1;
+        }
+        for (int i = 0; i < scope.size(); i++) {
+            csp.global_words[word_offset + n_tuple_words + i] = ~0ull;
+        }
+    }
+
+    // note: Pointer arithmetic rather than indexing, supports is empty without tuples (nothing is read then)
+    const uint64_t* support(int i, int x) const {
+        return supports.data() + (size_t)(support_offsets[i] + x)*n_tuple_words;
+    }
+
+    bool check(const CSP& csp) override {
+        auto& valid = scratch();
+        valid.assign(n_tuple_words, ~0ull);
+        for (int i = 0; i < scope.size(); i++) {
+            int x = csp.result[scope[i]->idx];
+            if (x == -1) {
+                continue;
+            }
+            if (x >= value_capacity[i]) {
+                return false;
+            }
+            auto bits = support(i, x);
+            for (int w = 0; w < n_tuple_words; w++) {
+                valid[w] &= bits[w];
+            }
+        }
+        for (int w = 0; w < n_tuple_words; w++) {
+            if (valid[w] & (w + 1 < n_tuple_words || (n_tuples & 63) == 0 ? ~0ull : (1ull << (n_tuples & 63)) - 1)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool propagate(CSP& csp) override {
+        uint64_t* current = &csp.global_words[word_offset];
+        auto& mask = scratch();
+
+        // Tuples invalidated by the values removed since the last call, only for variables whose domain changed
+        for (int i = 0; i < scope.size(); i++) {
+            int var = scope[i]->idx;
+            uint64_t size = csp.result[var] != -1 ? 1 : csp.domains[var].size();
+            if (size == current[n_tuple_words + i]) {
+                continue;
+            }
+            mask.assign(n_tuple_words, 0);
+            for (int x = csp_first_value(csp, var); x != -1 && x < value_capacity[i]; x = csp_next_value(csp, var, x)) {
+                auto bits = support(i, x);
+                for (int w = 0; w < n_tuple_words; w++) {
+                    mask[w] |= bits[w];
+                }
+            }
+            for (int w = 0; w < n_tuple_words; w++) {
+                csp.set_word(word_offset + w, current[w] & mask[w]);
+            }
+            csp.set_word(word_offset + n_tuple_words + i, size);
+        }
+
+        bool empty = true;
+        for (int w = 0; w < n_tuple_words && empty; w++) {
+            empty = current[w] == 0;
+        }
+        if (empty) {
+            return false;
+        }
+
+        for (int i = 0; i < scope.size(); i++) {
+            int var = scope[i]->idx;
+            if (csp.result[var] != -1) {
+                continue;
+            }
+            auto& domain = csp.domains[var];
+            for (int x = domain.first(); x != -1; x = domain.next(x)) {
+                bool supported = false;
+                if (x < value_capacity[i]) {
+                    auto bits = support(i, x);
+                    for (int w = 0; w < n_tuple_words && !supported; w++) {
+                        supported = (bits[w] & current[w]) != 0;
+                    }
+                }
+                if (!supported) {
+                    csp.remove_value(var, x);
+                }
+            }
+            if (domain.empty()) {
+                return false;
+            }
+            csp.set_word(word_offset + n_tuple_words + i, domain.size());
+        }
+        return true;
+    }
+
+    private:
+        static std::vector<uint64_t>& scratch() {
+            static thread_local std::vector<uint64_t> words;
+            return words;
+        }
+};
+
+enum class CSP_Relation {
+    less_equal,
+    equal,
+    greater_equal
+};
+
+// sum(coefficients[i]*scope[i]) relation constant. Propagated on the bounds of the domains: each term is kept within
+// what the others leave at their most favorable bound, until no bound moves.
+struct CSP_Linear : CSP_GlobalConstraint {
+    std::vector<int> coefficients;
+    CSP_Relation relation = CSP_Relation::equal;
+    long long constant = 0;
+
+    CSP_Linear(std::vector<CSP_Variable*> new_scope, std::vector<int> new_coefficients, CSP_Relation new_relation, long long new_constant)
+        : coefficients(std::move(new_coefficients)), relation(new_relation), constant(new_constant) {
+            scope = std::move(new_scope);
+            for (auto var : scope) {
+                var->globals.push_back(this);
+            }
+        }
+
+    // Smallest and largest possible sums
+    bool bounds(const CSP& csp, long long& sum_min, long long& sum_max) const {
+        sum_min = 0;
+        sum_max = 0;
+        for (int i = 0; i < scope.size(); i++) {
+            int var = scope[i]->idx;
+            int first = csp_first_value(csp, var);
+            if (first == -1) {
+                return false;
+            }
+            long long low = (long long)coefficients[i]*first;
+            long long high = (long long)coefficients[i]*csp_last_value(csp, var);
+            sum_min += low < high ? low : high;
+            sum_max += low < high ? high : low;
+        }
+        return true;
+    }
+
+    bool feasible(long long sum_min, long long sum_max) const {
+        return (relation == CSP_Relation::greater_equal || sum_min <= constant) && (relation == CSP_Relation::less_equal || sum_max >= constant);
+    }
+
+    bool check(const CSP& csp) override {
+        long long sum_min, sum_max;
+        if (!bounds(csp, sum_min, sum_max)) {
+            // An empty domain is for propagation to report, only assigned values count here
+            return true;
+        }
+        return feasible(sum_min, sum_max);
+    }
+
+    static long long floor_div(long long a, long long b) {
+        long long q = a / b;
+        return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+    }
+
+    static long long ceil_div(long long a, long long b) {
+        long long q = a / b;
+        return (a % b != 0 && (a < 0) == (b < 0)) ? q + 1 : q;
+    }
+
+    bool propagate(CSP& csp) override {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            long long sum_min, sum_max;
+            if (!bounds(csp, sum_min, sum_max) || !feasible(sum_min, sum_max)) {
+                return false;
+            }
+            for (int i = 0; i < scope.size(); i++) {
+                int var = scope[i]->idx;
+                long long a = coefficients[i];
+                if (csp.result[var] != -1 || a == 0) {
+                    continue;
+                }
+                auto& domain = csp.domains[var];
+                long long term_low = a*domain.first();
+                long long term_high = a*domain.last();
+                long long term_min = term_low < term_high ? term_low : term_high;
+                long long term_max = term_low < term_high ? term_high : term_low;
+
+                // Allowed range of a*x, then of x
+                long long allowed_min = relation == CSP_Relation::less_equal ? term_min : constant - (sum_max - term_max);
+                long long allowed_max = relation == CSP_Relation::greater_equal ? term_max : constant - (sum_min - term_min);
+                long long x_min = a > 0 ? ceil_div(allowed_min, a) : ceil_div(allowed_max, a);
+                long long x_max = a > 0 ? floor_div(allowed_max, a) : floor_div(allowed_min, a);
+
+                while (!domain.empty() && domain.first() < x_min) {
+                    csp.remove_value(var, domain.first());
+                    changed = true;
+                }
+                while (!domain.empty() && domain.last() > x_max) {
+                    csp.remove_value(var, domain.last());
+                    changed = true;
+                }
+                if (domain.empty()) {
+                    return false;
+                }
+                if (changed) {
+                    break;
+                }
+            }
         }
+        return true;
     }
 };
@@ -0,0 +1,651 @@
+#pragma once
+#include "blast_rush.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <typeinfo>
+#include <vector>
+
+using namespace blast;
+
+constexpr uint64_t FNV1A_OFFSET = 14695981039346656037ull;
+
+// FNV-1a 64 bits of n_bytes at data, continuing from hash
+inline uint64_t fnv1a(uint64_t hash, const void* data, size_t n_bytes) {
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < n_bytes; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// One constant jerk segment of a joint motion, acceleration is the one at the beginning of the segment
+struct ProfilePhase {
+    real duration = 0;
+    real acceleration = 0;
+    real jerk = 0;
+};
+
+// Motion of a single joint, as a sequence of constant jerk segments from (start_position, start_velocity)
+struct JointProfile {
+    real start_position = 0;
+    real start_velocity = 0;
+    std::vector<ProfilePhase> phases = {};
+
+    real duration() const {
+        real result = 0;
+        for (const auto& phase : phases) {
+            result += phase.duration;
+        }
+        return result;
+    }
+
+    // note: Past the end of the profile, the joint keeps its final velocity
+    void sample(real t, real& position, real& velocity, real& acceleration) const {
+        position = start_position;
+        velocity = start_velocity;
+        acceleration = 0;
+        for (const auto& phase : phases) {
+            real dt = t < phase.duration ? t : phase.duration;
+            position += velocity*dt + 0.5*phase.acceleration*dt*dt + phase.jerk*dt*dt*dt/6;
+            velocity += phase.acceleration*dt + 0.5*phase.jerk*dt*dt;
+            t -= dt;
+            if (t <= 0) {
+                acceleration = phase.acceleration + phase.jerk*dt;
+                return;
+            }
+        }
+        position += velocity*t;
+    }
+};
+
+// Motion of the whole manipulator between two joint states
+struct MotionProfile {
+    real duration = 0;
+    std::vector<JointProfile> joints = {};
+    bool synchronized = true; // False when a joint could not be stretched to duration, it then ends on its own
+
+    void sample(real t, Array& position, Array& velocity, Array& acceleration) const {
+        int n_joints = joints.size();
+        position = Array(n_joints);
+        velocity = Array(n_joints);
+        acceleration = Array(n_joints);
+        for (int i = 0; i < n_joints; i++) {
+            joints[i].sample(t, position[i], velocity[i], acceleration[i]);
+        }
+    }
+};
+
+// Time to ramp from rest to velocity v, with acceleration limit a and jerk limit j (the acceleration phase of an S-curve).
+// note: The distance covered is always v*time/2, ramps are symmetric in jerk.
+inline real s_curve_ramp_time(real v, real a, real j) {
+    real t_limited = v/a + a/j;    // Acceleration reaches a, then stays there
+    real t_free = 2*std::sqrt(v/j); // Acceleration peaks under a
+    return v >= a*a/j ? t_limited : t_free;
+}
+
+// Limits of a rest to rest S-curve in its direction of motion, with the divisions the kernel needs done once
+struct SCurveLimits {
+    real v_top = 0;
+    real a_up = 0;
+    real a_down = 0;
+    real j = 0;
+    real inv_a_up = 0;
+    real inv_a_down = 0;
+    real inv_j = 0;
+    real v_limited_up = 0;   // Velocity from which ramping up reaches a_up
+    real v_limited_down = 0; // Velocity from which ramping down reaches a_down
+    // Square roots of the above for the peak velocity solver, and of j
+    real u_top = 0;
+    real u_limited_up = 0;
+    real u_limited_down = 0;
+    real sqrt_j = 0;
+    real inv_sqrt_j = 0;
+
+    SCurveLimits() = default;
+    SCurveLimits(real new_v_top, real new_a_up, real new_a_down, real new_j)
+        : v_top(new_v_top), a_up(new_a_up), a_down(new_a_down), j(new_j),
+          inv_a_up(1/new_a_up), inv_a_down(1/new_a_down), inv_j(1/new_j),
+          v_limited_up(new_a_up*new_a_up/new_j), v_limited_down(new_a_down*new_a_down/new_j),
+          u_top(std::sqrt(new_v_top)), sqrt_j(std::sqrt(new_j)), inv_sqrt_j(1/std::sqrt(new_j)) {
+            u_limited_up = new_a_up*inv_sqrt_j;
+            u_limited_down = new_a_down*inv_sqrt_j;
+        }
+
+    // Going up accelerates with amax and decelerates with amin, going down the other way around
+    static SCurveLimits of_direction(bool up, real vmax, real vmin, real amax, real amin, real jmax) {
+        return SCurveLimits(up ? std::abs(vmax) : std::abs(vmin), up ? std::abs(amax) : std::abs(amin), up ? std::abs(amin) : std::abs(amax), std::abs(jmax));
+    }
+
+    // Field by field with up being 1 or 0, so that it compiles to arithmetic in vectorized loops: blends on floating
+    // point comparisons only vectorize when trapping math is disabled. The fields are finite, the result is exact.
+    static SCurveLimits select(real up, const SCurveLimits& if_up, const SCurveLimits& if_down) {
+        real down = 1 - up;
+        SCurveLimits result;
+        result.v_top = up*if_up.v_top + down*if_down.v_top;
+        result.a_up = up*if_up.a_up + down*if_down.a_up;
+        result.a_down = up*if_up.a_down + down*if_down.a_down;
+        result.j = up*if_up.j + down*if_down.j;
+        result.inv_a_up = up*if_up.inv_a_up + down*if_down.inv_a_up;
+        result.inv_a_down = up*if_up.inv_a_down + down*if_down.inv_a_down;
+        result.inv_j = up*if_up.inv_j + down*if_down.inv_j;
+        result.v_limited_up = up*if_up.v_limited_up + down*if_down.v_limited_up;
+        result.v_limited_down = up*if_up.v_limited_down + down*if_down.v_limited_down;
+        result.u_top = up*if_up.u_top + down*if_down.u_top;
+        result.u_limited_up = up*if_up.u_limited_up + down*if_down.u_limited_up;
+        result.u_limited_down = up*if_up.u_limited_down + down*if_down.u_limited_down;
+        result.sqrt_j = up*if_up.sqrt_j + down*if_down.sqrt_j;
+        result.inv_sqrt_j = up*if_up.inv_sqrt_j + down*if_down.inv_sqrt_j;
+        return result;
+    }
+};
+
+// Branch free square and cube roots without libm calls, which compilers only vectorize with -fno-math-errno: the bits
+// of the nearest float give a guess within a few percent, which two Newton steps refine to about 1e-6.
+// note: Meant for seeds of x >= 0, far less precise outside of the normal float range (0 gives a tiny positive value).
+inline real approximate_sqrt(real x) {
+    float guess = (float)x;
+    int32_t bits;
+    std::memcpy(&bits, &guess, sizeof(bits));
+    bits = 0x1fbd1df5 + (bits >> 1);
+    std::memcpy(&guess, &bits, sizeof(bits));
+    real y = guess;
+    y = 0.5*(y + x/y);
+    return 0.5*(y + x/y);
+}
+
+inline real approximate_cbrt(real x) {
+    float guess = (float)x;
+    int32_t bits;
+    std::memcpy(&bits, &guess, sizeof(bits));
+    bits = (int32_t)(bits*(1.0/3)) + 709921077; // Multiplying instead of dividing the integer, which does not vectorize everywhere
+    std::memcpy(&guess, &bits, sizeof(bits));
+    real y = guess;
+    y = (2*y + x/(y*y))*(real)(1.0/3);
+    return (2*y + x/(y*y))*(real)(1.0/3);
+}
+
+// The peak velocity v of a rest to rest move over distance d >= 0 solves v*(t_up(v) + t_down(v))/2 = d. It is solved
+// for u = sqrt(v), in which ramp times need no square root: t = 2*u/sqrt(j), or u^2/a + a/j at the acceleration limit.
+// The left side is then convex, increasing and C1 in u, so Newton converges monotonically once right of the root.
+// The root lies between the ones with both ramps at their acceleration limit (a quadratic in v) and with neither (2*u^3/sqrt(j) = d),
+// and is one of them unless exactly one ramp reaches its limit, which is when u is between u_limited_up and u_limited_down.
+inline real s_curve_peak_root_start(real d, const SCurveLimits& limits) {
+    real u_free = approximate_cbrt(0.5*d*limits.sqrt_j);
+    real b = 0.5*(limits.a_up + limits.a_down)*limits.inv_j;
+    real c = 0.5*(limits.inv_a_up + limits.inv_a_down);
+    real u_limited = approximate_sqrt(2*d/(b + approximate_sqrt(b*b + 4*c*d)));
+    real u = std::max(u_limited, std::max(limits.u_limited_up, limits.u_limited_down));
+    u = std::min(u, std::min(u_free, limits.u_top));
+    return std::max(u, (real)1e-6);
+}
+
+// Ramp times from rest to u^2, summed over both ramps, and their derivative in u. Past u_limited a ramp spends
+// 2*u_limited/sqrt(j) getting to the acceleration limit, then (u^2 - u_limited^2)/a at it.
+// note: Written with min, which compilers vectorize while trapping math is enabled (the default), unlike other selects.
+// note: gcc only keeps the mins branch free when they are computed in the function inlined in the loop, not in a helper.
+struct SCurveRamps {
+    real time;
+    real derivative;
+
+    SCurveRamps(real u, const SCurveLimits& limits) {
+        real u_free_up = std::min(u, limits.u_limited_up);
+        real u_free_down = std::min(u, limits.u_limited_down);
+        time = 2*(u_free_up + u_free_down)*limits.inv_sqrt_j + (u - u_free_up)*(u + u_free_up)*limits.inv_a_up + (u - u_free_down)*(u + u_free_down)*limits.inv_a_down;
+        derivative = 4*limits.inv_sqrt_j + 2*(u - u_free_up)*limits.inv_a_up + 2*(u - u_free_down)*limits.inv_a_down;
+    }
+};
+
+inline real s_curve_peak_root_step(real u, real d, const SCurveLimits& limits) {
+    real v = u*u;
+    SCurveRamps ramps(u, limits);
+    real f = 0.5*v*ramps.time - d;
+    real df = u*ramps.time + 0.5*v*ramps.derivative;
+    real next = u - f/df;
+    next = std::min(next, limits.u_top); // f <= 0 at u_top means the move cruises at v_top
+    return std::max(next, (real)1e-6);
+}
+
+// Fixed count instead of a tolerance, so that every lane of the batched kernel does the same work. The seed is within
+// about 1e-6 of the root unless exactly one ramp reaches its limit, where the count still converges for accelerations
+// up to a factor 2 apart. Roots still moving after it go through s_curve_peak_root_converge(), whatever j/a^2 is.
+constexpr int S_CURVE_NEWTON_ITERATIONS = 5;
+constexpr int S_CURVE_MAX_NEWTON_ITERATIONS = 100;
+constexpr real S_CURVE_TOLERANCE = 64*std::numeric_limits<real>::epsilon(); // Relative step under which u stopped moving
+
+inline bool s_curve_peak_root_moved(real u, real previous_u) {
+    return std::abs(u - previous_u) > S_CURVE_TOLERANCE*previous_u;
+}
+
+// Newton steps until u stops moving
+inline real s_curve_peak_root_converge(real u, real d, const SCurveLimits& limits) {
+    for (int i = 0; i < S_CURVE_MAX_NEWTON_ITERATIONS; i++) {
+        real next = s_curve_peak_root_step(u, d, limits);
+        if (!s_curve_peak_root_moved(next, u)) {
+            return next;
+        }
+        u = next;
+    }
+    return u;
+}
+
+inline real s_curve_peak_root(real d, const SCurveLimits& limits) {
+    real u = s_curve_peak_root_start(d, limits);
+    for (int i = 0; i < S_CURVE_NEWTON_ITERATIONS - 1; i++) {
+        u = s_curve_peak_root_step(u, d, limits);
+    }
+    // Last step, checked
+    real next = s_curve_peak_root_step(u, d, limits);
+    return s_curve_peak_root_moved(next, u) ? s_curve_peak_root_converge(next, d, limits) : next;
+}
+
+inline real s_curve_peak_velocity(real d, const SCurveLimits& limits) {
+    real u = s_curve_peak_root(d, limits);
+    return u*u;
+}
+
+// Rest to rest time over distance d (d >= 0) cruising at v_cruise, which must not cover more than d while ramping
+inline real s_curve_cruise_time(real d, real v_cruise, const SCurveLimits& limits) {
+    real t_free = 2*std::sqrt(v_cruise*limits.inv_j);
+    real t_up = v_cruise >= limits.v_limited_up ? v_cruise*limits.inv_a_up + limits.a_up*limits.inv_j : t_free;
+    real t_down = v_cruise >= limits.v_limited_down ? v_cruise*limits.inv_a_down + limits.a_down*limits.inv_j : t_free;
+    real d_cruise = d - 0.5*v_cruise*(t_up + t_down);
+    real t_cruise = d_cruise/v_cruise;
+    return t_up + t_down + (d_cruise > 0 ? t_cruise : 0);
+}
+
+// Same as s_curve_cruise_time() from the root u = sqrt(v_cruise), without square root
+inline real s_curve_root_cruise_time(real d, real u, const SCurveLimits& limits) {
+    SCurveRamps ramps(u, limits);
+    real d_cruise = d - 0.5*u*u*ramps.time;
+    return ramps.time + std::max(d_cruise, (real)0)/(u*u);
+}
+
+// Jerk limited (S-curve) counterpart of trapezoidal_velocity_profile_time(real, ...), for a single joint starting and ending at rest
+inline real s_curve_velocity_profile_time(real task_displacement, real vmax, real vmin, real amax, real amin, real jmax) {
+    real d = std::abs(task_displacement);
+    auto limits = SCurveLimits::of_direction(task_displacement >= 0, vmax, vmin, amax, amin, jmax);
+    return d > 0 ? s_curve_root_cruise_time(d, s_curve_peak_root(d, limits), limits) : 0;
+}
+
+// Displacements handled at once by the batched kernel, small enough for its buffers to stay in L1
+constexpr int S_CURVE_BATCH = 256;
+
+// Batched kernel: times[k] for displacements[k] of the same joint, same result as the scalar one.
+// Chunks of S_CURVE_BATCH displacements go through branch free passes over fixed size arrays, one per Newton
+// iteration, which compilers vectorize with the default floating point flags (the kernel calls no libm function).
+inline void s_curve_velocity_profile_time(const real* displacements, int n, real vmax, real vmin, real amax, real amin, real jmax, real* times) {
+    auto limits_up = SCurveLimits::of_direction(true, vmax, vmin, amax, amin, jmax);
+    auto limits_down = SCurveLimits::of_direction(false, vmax, vmin, amax, amin, jmax);
+
+    real distances[S_CURVE_BATCH];
+    real up[S_CURVE_BATCH];     // 1 or 0, see SCurveLimits::select()
+    real moving[S_CURVE_BATCH]; // 1 or 0, times of zero displacements are exactly 0
+    real roots[S_CURVE_BATCH];
+    real unconverged[S_CURVE_BATCH];
+    real chunk_times[S_CURVE_BATCH];
+    for (int first = 0; first < n; first += S_CURVE_BATCH) {
+        // The last chunk is padded with zero displacements
+        int n_chunk = n - first < S_CURVE_BATCH ? n - first : S_CURVE_BATCH;
+        for (int k = 0; k < n_chunk; k++) {
+            up[k] = displacements[first + k] >= 0;
+            distances[k] = std::abs(displacements[first + k]);
+            moving[k] = distances[k] > 0;
+        }
+        for (int k = n_chunk; k < S_CURVE_BATCH; k++) {
+            up[k] = 1;
+            distances[k] = 0;
+            moving[k] = 0;
+        }
+
+        for (int k = 0; k < S_CURVE_BATCH; k++) {
+            roots[k] = s_curve_peak_root_start(distances[k], SCurveLimits::select(up[k], limits_up, limits_down));
+        }
+        for (int i = 0; i < S_CURVE_NEWTON_ITERATIONS - 1; i++) {
+            for (int k = 0; k < S_CURVE_BATCH; k++) {
+                roots[k] = s_curve_peak_root_step(roots[k], distances[k], SCurveLimits::select(up[k], limits_up, limits_down));
+            }
+        }
+        for (int k = 0; k < S_CURVE_BATCH; k++) {
+            real next = s_curve_peak_root_step(roots[k], distances[k], SCurveLimits::select(up[k], limits_up, limits_down));
+            // Positive when the step moved, s_curve_peak_root_moved() as arithmetic
+            unconverged[k] = std::abs(next - roots[k]) - S_CURVE_TOLERANCE*roots[k];
+            roots[k] = next;
+        }
+        for (int k = 0; k < n_chunk; k++) {
+            if (unconverged[k] > 0) {
+                roots[k] = s_curve_peak_root_converge(roots[k], distances[k], up[k] != 0 ? limits_up : limits_down);
+            }
+        }
+
+        for (int k = 0; k < S_CURVE_BATCH; k++) {
+            chunk_times[k] = moving[k]*s_curve_root_cruise_time(distances[k], roots[k], SCurveLimits::select(up[k], limits_up, limits_down));
+        }
+        for (int k = 0; k < n_chunk; k++) {
+            times[first + k] = chunk_times[k];
+        }
+    }
+}
+
+// Cost (time) of moving the manipulator between two joint states.
+// Implementations fill profile, when it is not null, with the motion the time was computed for, so that the
+// trajectory executed after sequencing needs no recomputation.
+// note: One model may be shared by several problems and streams, and evaluated from several threads at once: evaluate()
+// and evaluate_batch() must not keep per-call state in the model.
+struct CostModel {
+    virtual real evaluate(const Array& start_position, const Array& start_velocity, const Array& end_position, const Array& end_velocity, const GenericManipulator& manip, MotionProfile* profile = nullptr) = 0; // Pure virtual
+
+    // Rest to rest times from start_position to n_targets positions, with joint q of target k at target_positions[q*n_targets + k].
+    // Returns false when the model has no batched form, setup() then calls evaluate() pair by pair.
+    virtual bool evaluate_batch(const Array& /*start_position*/, const real* /*target_positions*/, int /*n_targets*/, const GenericManipulator& /*manip*/, real* /*times*/) {
+        return false;
+    }
+
+    // Identifies the model and its parameters for problem_fingerprint(), models giving different costs must differ.
+    // The default only tells the types apart, models with parameters add them.
+    virtual uint64_t fingerprint() const {
+        const char* name = typeid(*this).name();
+        return fnv1a(FNV1A_OFFSET, name, std::strlen(name));
+    }
+
+    virtual ~CostModel() = default;
+};
+
+// Trapezoidal velocity profiles with non zero boundary velocities.
+// With synchronize, every joint is slowed down to finish with the slowest one, which is what the manipulator executes.
+// note: With zero boundary velocities, the time is the same as trapezoidal_velocity_profile_time().
+struct TrapezoidalCostModel : CostModel {
+    bool synchronize = true;
+
+    TrapezoidalCostModel(bool new_synchronize = true)
+        : synchronize(new_synchronize) {}
+
+    uint64_t fingerprint() const override {
+        return fnv1a(CostModel::fingerprint(), &synchronize, sizeof(synchronize));
+    }
+
+    real evaluate(const Array& start_position, const Array& start_velocity, const Array& end_position, const Array& end_velocity, const GenericManipulator& manip, MotionProfile* profile = nullptr) override {
+        int n_joints = manip.joints;
+        std::vector<JointProfile> joint_profiles(n_joints);
+
+        real duration = 0;
+        for (int i = 0; i < n_joints; i++) {
+            real start_vel = start_velocity.size == 0 ? 0 : start_velocity[i];
+            real end_vel = end_velocity.size == 0 ? 0 : end_velocity[i];
+            joint_profiles[i] = joint_profile(end_position[i] - start_position[i], start_vel, end_vel, manip, i, -1);
+            joint_profiles[i].start_position = start_position[i];
+            real joint_duration = joint_profiles[i].duration();
+            duration = joint_duration > duration ? joint_duration : duration;
+        }
+
+        if (!profile) {
+            return duration;
+        }
+
+        if (synchronize) {
+            for (int i = 0; i < n_joints; i++) {
+                if (joint_profiles[i].duration() < duration) {
+                    real start_vel = start_velocity.size == 0 ? 0 : start_velocity[i];
+                    real end_vel = end_velocity.size == 0 ? 0 : end_velocity[i];
+                    joint_profiles[i] = joint_profile(end_position[i] - start_position[i], start_vel, end_vel, manip, i, duration);
+                    joint_profiles[i].start_position = start_position[i];
+                }
+            }
+        }
+
+        profile->duration = duration;
+        profile->synchronized = true;
+        for (int i = 0; synchronize && i < n_joints; i++) {
+            if (std::abs(joint_profiles[i].duration() - duration) > 1e-9*(1 + duration)) {
+                profile->synchronized = false;
+            }
+        }
+        profile->joints = std::move(joint_profiles);
+        return duration;
+    }
+
+    // Single joint profile. With duration < 0 it is the fastest one, otherwise it is stretched to last duration.
+    static JointProfile joint_profile(real displacement, real start_vel, real end_vel, const GenericManipulator& manip, int joint, real duration) {
+        // Work in the direction of motion: accelerating uses amax going up and amin going down, like trapezoidal_velocity_profile_time()
+        real direction = displacement < 0 ? -1 : 1;
+        real v_top = direction > 0 ? std::abs(manip.vmax[joint]) : std::abs(manip.vmin[joint]);
+        real a_up = direction > 0 ? std::abs(manip.amax[joint]) : std::abs(manip.amin[joint]);
+        real a_down = direction > 0 ? std::abs(manip.amin[joint]) : std::abs(manip.amax[joint]);
+
+        real d = direction*displacement;
+        real v0 = direction*start_vel;
+        real v1 = direction*end_vel;
+
+        JointProfile result;
+        result.start_velocity = start_vel;
+
+        if (d == 0 && v0 == 0 && v1 == 0) {
+            if (duration > 0) {
+                result.phases.push_back({duration, 0});
+            }
+            return result;
+        }
+
+        // Peak velocity must be reached from v0 and allow stopping at v1 within the displacement
+        real v_floor = std::max({v0, v1, (real)0});
+        real d_floor = (v_floor*v_floor - v0*v0)/(2*a_up) + (v_floor*v_floor - v1*v1)/(2*a_down);
+        if (d < d_floor) {
+            return rest_to_rest_profile(displacement, start_vel, end_vel, manip, joint, duration);
+        }
+
+        real v_peak = std::sqrt((2*a_up*a_down*d + a_down*v0*v0 + a_up*v1*v1)/(a_up + a_down));
+        if (v_peak > v_top) {
+            v_peak = v_top;
+        }
+
+        if (duration > 0) {
+            // Lower the cruise velocity until the profile lasts exactly duration. Duration decreases with the cruise
+            // velocity, which can go under v0 or v1 (slow down, then speed up again to end_vel).
+            real v_low = 0;
+            real v_high = v_peak;
+            for (int i = 0; i < 100; i++) {
+                real v_mid = 0.5*(v_low + v_high);
+                if (cruise_duration(d, v0, v1, v_mid, a_up, a_down) > duration) {
+                    v_low = v_mid;
+                } else {
+                    v_high = v_mid;
+                }
+            }
+            if (std::abs(cruise_duration(d, v0, v1, v_high, a_up, a_down) - duration) < 1e-9*(1 + duration)) {
+                return cruise_profile(d, v0, v1, v_high, a_up, a_down, direction, start_vel);
+            }
+            if (v1 == 0) {
+                // Cannot be slowed down enough, wait at the end instead
+                result = joint_profile(displacement, start_vel, end_vel, manip, joint, -1);
+                result.phases.push_back({duration - result.duration(), 0});
+                return result;
+            }
+            // Otherwise stop on the way and wait there
+            result = rest_to_rest_profile(displacement, start_vel, end_vel, manip, joint, duration);
+            if (std::abs(result.duration() - duration) < 1e-9*(1 + duration)) {
+                return result;
+            }
+            // note: Even stopping takes longer than duration, the joint keeps its fastest profile (evaluate() reports it)
+        }
+
+        return cruise_profile(d, v0, v1, v_peak, a_up, a_down, direction, start_vel);
+    }
+
+    // Ramp from v0 to v_cruise, cruise, then ramp to v1, in the direction of motion. Infinite if the ramps overshoot d.
+    static real cruise_duration(real d, real v0, real v1, real v_cruise, real a_up, real a_down) {
+        real a_1 = v_cruise > v0 ? a_up : -a_down;
+        real a_2 = v1 > v_cruise ? a_up : -a_down;
+        real d_cruise = d - (v_cruise*v_cruise - v0*v0)/(2*a_1) - (v1*v1 - v_cruise*v_cruise)/(2*a_2);
+        if (d_cruise < -1e-12*(1 + d) || v_cruise <= 0) {
+            return INF_REAL;
+        }
+        real t_cruise = d_cruise > 0 ? d_cruise/v_cruise : 0;
+        return (v_cruise - v0)/a_1 + t_cruise + (v1 - v_cruise)/a_2;
+    }
+
+    static JointProfile cruise_profile(real d, real v0, real v1, real v_cruise, real a_up, real a_down, real direction, real start_vel) {
+        real a_1 = v_cruise > v0 ? a_up : -a_down;
+        real a_2 = v1 > v_cruise ? a_up : -a_down;
+        real d_cruise = d - (v_cruise*v_cruise - v0*v0)/(2*a_1) - (v1*v1 - v_cruise*v_cruise)/(2*a_2);
+
+        JointProfile result;
+        result.start_velocity = start_vel;
+        result.phases.push_back({(v_cruise - v0)/a_1, direction*a_1});
+        result.phases.push_back({d_cruise > 0 && v_cruise > 0 ? d_cruise/v_cruise : 0, 0});
+        result.phases.push_back({(v1 - v_cruise)/a_2, direction*a_2});
+        return result;
+    }
+
+    // Fallback when boundary velocities cannot be met within the displacement: brake to rest, move rest to rest, launch to end_vel.
+    // With duration > 0 the rest to rest move is slowed down so that the whole profile lasts duration, when it can.
+    static JointProfile rest_to_rest_profile(real displacement, real start_vel, real end_vel, const GenericManipulator& manip, int joint, real duration = -1) {
+        real brake = start_vel > 0 ? std::abs(manip.amin[joint]) : std::abs(manip.amax[joint]);
+        real launch = end_vel > 0 ? std::abs(manip.amax[joint]) : std::abs(manip.amin[joint]);
+        real t_brake = std::abs(start_vel)/brake;
+        real t_launch = std::abs(end_vel)/launch;
+        real d_brake = 0.5*start_vel*t_brake;
+        real d_launch = 0.5*end_vel*t_launch;
+
+        JointProfile result;
+        result.start_velocity = start_vel;
+        result.phases.push_back({t_brake, start_vel > 0 ? -brake : brake});
+
+        real d_middle = displacement - d_brake - d_launch;
+        auto middle = joint_profile(d_middle, 0, 0, manip, joint, -1);
+        if (duration > 0 && t_brake + middle.duration() + t_launch < duration) {
+            middle = joint_profile(d_middle, 0, 0, manip, joint, duration - t_brake - t_launch);
+        }
+        result.phases.insert(result.phases.end(), middle.phases.begin(), middle.phases.end());
+
+        result.phases.push_back({t_launch, end_vel > 0 ? launch : -launch});
+        return result;
+    }
+};
+
+// Jerk limited (S-curve) profiles, for manipulators whose controller limits jerk. Trapezoidal times underestimate their moves.
+// note: GenericManipulator has no jerk limits, they are given here, one per joint.
+// note: Moves are rest to rest, boundary velocities are ignored.
+struct SCurveCostModel : CostModel {
+    Array jmax = {};
+    bool synchronize = true;
+
+    SCurveCostModel(Array new_jmax, bool new_synchronize = true)
+        : jmax(new_jmax), synchronize(new_synchronize) {}
+
+    uint64_t fingerprint() const override {
+        uint64_t hash = fnv1a(CostModel::fingerprint(), &synchronize, sizeof(synchronize));
+        hash = fnv1a(hash, &jmax.size, sizeof(jmax.size));
+        for (int i = 0; i < jmax.size; i++) {
+            real value = jmax[i];
+            hash = fnv1a(hash, &value, sizeof(value));
+        }
+        return hash;
+    }
+
+    real evaluate(const Array& start_position, const Array& /*start_velocity*/, const Array& end_position, const Array& /*end_velocity*/, const GenericManipulator& manip, MotionProfile* profile = nullptr) override {
+        int n_joints = manip.joints;
+        Assert(jmax.size == n_joints);
+
+        real duration = 0;
+        for (int i = 0; i < n_joints; i++) {
+            real joint_duration = s_curve_velocity_profile_time(end_position[i] - start_position[i], manip.vmax[i], manip.vmin[i], manip.amax[i], manip.amin[i], jmax[i]);
+            duration = joint_duration > duration ? joint_duration : duration;
+        }
+
+        if (profile) {
+            profile->duration = duration;
+            profile->joints.resize(n_joints);
+            for (int i = 0; i < n_joints; i++) {
+                profile->joints[i] = joint_profile(start_position[i], end_position[i], manip, i, synchronize ? duration : -1);
+            }
+        }
+        return duration;
+    }
+
+    bool evaluate_batch(const Array& start_position, const real* target_positions, int n_targets, const GenericManipulator& manip, real* times) override {
+        int n_joints = manip.joints;
+        Assert(jmax.size == n_joints);
+
+        auto& displacements = scratch(0);
+        auto& joint_times = scratch(1);
+        displacements.resize(n_targets);
+        joint_times.resize(n_targets);
+        for (int k = 0; k < n_targets; k++) {
+            times[k] = 0;
+        }
+        for (int q = 0; q < n_joints; q++) {
+            const real* targets = target_positions + (size_t)q*n_targets;
+            real start = start_position[q];
+            for (int k = 0; k < n_targets; k++) {
+                displacements[k] = targets[k] - start;
+            }
+            s_curve_velocity_profile_time(displacements.data(), n_targets, manip.vmax[q], manip.vmin[q], manip.amax[q], manip.amin[q], jmax[q], joint_times.data());
+            for (int k = 0; k < n_targets; k++) {
+                times[k] = joint_times[k] > times[k] ? joint_times[k] : times[k];
+            }
+        }
+        return true;
+    }
+
+    // With duration > 0, the cruise velocity is lowered so that the joint finishes at duration
+    JointProfile joint_profile(real start_pos, real end_pos, const GenericManipulator& manip, int joint, real duration) const {
+        real displacement = end_pos - start_pos;
+        real direction = displacement < 0 ? -1 : 1;
+        real d = std::abs(displacement);
+        auto limits = SCurveLimits::of_direction(direction > 0, manip.vmax[joint], manip.vmin[joint], manip.amax[joint], manip.amin[joint], jmax[joint]);
+
+        JointProfile result;
+        result.start_position = start_pos;
+        if (d == 0) {
+            if (duration > 0) {
+                result.phases.push_back({duration, 0, 0});
+            }
+            return result;
+        }
+
+        real v_cruise = s_curve_peak_velocity(d, limits);
+        if (duration > s_curve_cruise_time(d, v_cruise, limits)) {
+            // Time decreases with the cruise velocity
+            real v_low = 0;
+            real v_high = v_cruise;
+            for (int i = 0; i < 100; i++) {
+                real v_mid = 0.5*(v_low + v_high);
+                if (s_curve_cruise_time(d, v_mid, limits) > duration) {
+                    v_low = v_mid;
+                } else {
+                    v_high = v_mid;
+                }
+            }
+            v_cruise = v_high;
+        }
+
+        push_ramp(result.phases, v_cruise, limits.a_up, limits.j, direction);
+        real t_ramps = s_curve_ramp_time(v_cruise, limits.a_up, limits.j) + s_curve_ramp_time(v_cruise, limits.a_down, limits.j);
+        real d_cruise = d - 0.5*v_cruise*t_ramps;
+        result.phases.push_back({d_cruise > 0 ? d_cruise/v_cruise : 0, 0, 0});
+        push_ramp(result.phases, v_cruise, limits.a_down, limits.j, -direction);
+        return result;
+    }
+
+    private:
+        // Per thread, so that a shared model can be evaluated from several threads at once
+        static std::vector<real>& scratch(int i) {
+            static thread_local std::vector<real> buffers[2];
+            return buffers[i];
+        }
+
+        // Velocity change of v, in the direction of sign
+        static void push_ramp(std::vector<ProfilePhase>& phases, real v, real a, real j, real sign) {
+            if (v >= a*a/j) {
+                phases.push_back({a/j, 0, sign*j});
+                phases.push_back({v/a - a/j, sign*a, 0});
+                phases.push_back({a/j, sign*a, -sign*j});
+            } else {
+                real t = std::sqrt(v/j);
+                phases.push_back({t, 0, sign*j});
+                phases.push_back({t, sign*j*t, -sign*j});
+            }
+        }
+};
@@ -0,0 +1,319 @@
+#pragma once
+#include "constraints_satisfaction_problem.hpp"
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
+
+struct CSP_LocalSearchSettings {
+    long long max_steps = 100000;   // Moves per restart
+    int n_restarts = 8;             // In total, spread over the threads
+    int tabu_tenure = 10;           // Moves during which a variable cannot take back the value it left, unless that gives
+                                    // fewer violated constraints than the best assignment of the restart so far
+    double walk_probability = 0.02; // A move takes a random value instead of one with the fewest conflicts
+    unsigned seed = 0;              // Restart r is seeded with seed + r
+    int n_threads = 0;              // 0 uses every hardware thread
+};
+
+// One restart of min-conflicts local search over the model of a finalized CSP, which it only reads.
+// conflicts[offsets[v] + x] counts the constraints of variable v that value x violates with the other variables at
+// their current values. Moving variable w only changes the rows of the variables sharing a constraint with w, so a move
+// costs a few checks per value of those variables instead of a pass over every constraint.
+template <typename Constraint = CSP_Constraint>
+struct CSP_MinConflicts {
+    const CSP& problem;
+    CSP_LocalSearchSettings settings;
+    std::mt19937 random;
+
+    std::vector<int> values; // Current assignment, -1 for variables the greedy start has not placed yet
+    std::vector<int> offsets;
+    std::vector<int> conflicts;
+    std::vector<long long> tabu_until; // Same layout as conflicts: a value is tabu until that step
+    std::vector<int> conflicted;       // Variables whose value violates some constraint, in no particular order
+    std::vector<int> conflicted_position; // Position in conflicted, -1 when the variable is not in it
+    int n_violated = 0;
+    long long n_steps = 0;
+
+    CSP_MinConflicts(const CSP& new_problem, const CSP_LocalSearchSettings& new_settings)
+        : problem(new_problem), settings(new_settings) {
+            int n_variables = problem.model_variables.size();
+            offsets.assign(n_variables + 1, 0);
+            for (int v = 0; v < n_variables; v++) {
+                offsets[v + 1] = offsets[v] + domain(v).capacity;
+            }
+        }
+
+    const CSP_Domain& domain(int variable) const {
+        return problem.model_variables[variable]->domain;
+    }
+
+    // Constraint is violated by the current values, which must all be set for its variables
+    bool violated(int constraint) const {
+        auto& graph = problem.graph;
+        auto cons = problem.model_constraints[constraint];
+        CSP_Assignment a = {values.data(), (int)values.size()};
+        int output = graph.binary_output[constraint];
+        if (output != -1) {
+            return !csp_consistent<Constraint>(cons, a, values[output]);
+        }
+        for (int k = graph.output_offsets[constraint]; k < graph.scope_offsets[constraint + 1]; k++) {
+            if (!csp_consistent<Constraint>(cons, a, values[graph.scope[k]])) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void update_conflicted(int variable) {
+        bool is_conflicted = values[variable] != -1 && conflicts[offsets[variable] + values[variable]] > 0;
+        int& position = conflicted_position[variable];
+        if (is_conflicted && position == -1) {
+            position = conflicted.size();
+            conflicted.push_back(variable);
+        } else if (!is_conflicted && position != -1) {
+            conflicted_position[conflicted.back()] = position;
+            conflicted[position] = conflicted.back();
+            conflicted.pop_back();
+            position = -1;
+        }
+    }
+
+    // Adds sign times constraint to the row of variable, every other variable of the constraint being set
+    void add_row(int constraint, int variable, int sign = 1) {
+        auto& variable_domain = domain(variable);
+        int* row = &conflicts[offsets[variable]];
+        auto cons = problem.model_constraints[constraint];
+        CSP_Assignment a = {values.data(), (int)values.size()};
+        int output = problem.graph.binary_output[constraint];
+        int saved = values[variable];
+        if (output == variable) {
+            // Value of the output is an argument of consistent(), the assignment stays as it is
+            for (int x = variable_domain.first(); x != -1; x = variable_domain.next(x)) {
+                row[x] += sign*!csp_consistent<Constraint>(cons, a, x);
+            }
+        } else if (output != -1) {
+            int output_value = values[output];
+            for (int x = variable_domain.first(); x != -1; x = variable_domain.next(x)) {
+                values[variable] = x;
+                row[x] += sign*!csp_consistent<Constraint>(cons, a, output_value);
+            }
+        } else {
+            for (int x = variable_domain.first(); x != -1; x = variable_domain.next(x)) {
+                values[variable] = x;
+                row[x] += sign*violated(constraint);
+            }
+        }
+        values[variable] = saved;
+        update_conflicted(variable);
+    }
+
+    // Applies f(constraint, other variable) to every other variable of every constraint of variable
+    template <typename F>
+    void for_each_neighbor(int variable, F f) {
+        auto& graph = problem.graph;
+        for (int a = graph.arc_offsets[variable]; a < graph.arc_offsets[variable + 1]; a++) {
+            auto& arc = graph.arcs[a];
+            if (arc.other != -1) {
+                f(arc.idx, arc.other);
+                continue;
+            }
+            for (int k = graph.scope_offsets[arc.idx]; k < graph.scope_offsets[arc.idx + 1]; k++) {
+                if (graph.scope[k] != variable) {
+                    f(arc.idx, graph.scope[k]);
+                }
+            }
+        }
+    }
+
+    // Greedy start: variable takes x, and the constraints it completes enter the rows of their variables. A constraint
+    // enters the row of a variable once all its other variables are placed.
+    void place(int variable, int x) {
+        values[variable] = x;
+        auto& graph = problem.graph;
+        for (int a = graph.arc_offsets[variable]; a < graph.arc_offsets[variable + 1]; a++) {
+            auto& arc = graph.arcs[a];
+            if (arc.other != -1) {
+                add_row(arc.idx, arc.other);
+                continue;
+            }
+            int n_unplaced = 0;
+            int unplaced = -1;
+            for (int k = graph.scope_offsets[arc.idx]; k < graph.scope_offsets[arc.idx + 1]; k++) {
+                if (values[graph.scope[k]] == -1) {
+                    n_unplaced++;
+                    unplaced = graph.scope[k];
+                }
+            }
+            if (n_unplaced == 1) {
+                add_row(arc.idx, unplaced);
+            } else if (n_unplaced == 0) {
+                for (int k = graph.scope_offsets[arc.idx]; k < graph.scope_offsets[arc.idx + 1]; k++) {
+                    if (graph.scope[k] != variable) {
+                        add_row(arc.idx, graph.scope[k]);
+                    }
+                }
+            }
+        }
+        update_conflicted(variable);
+    }
+
+    void move(int variable, int x) {
+        int old_value = values[variable];
+        n_violated += conflicts[offsets[variable] + x] - conflicts[offsets[variable] + old_value];
+        for_each_neighbor(variable, [&](int constraint, int other) {
+            values[variable] = old_value;
+            add_row(constraint, other, -1);
+            values[variable] = x;
+            add_row(constraint, other);
+        });
+        values[variable] = x;
+        update_conflicted(variable);
+    }
+
+    // Next value of variable: a random one with probability walk_probability, otherwise the one with the fewest
+    // conflicts that is not tabu. The current value is never picked, -1 when no other value is allowed.
+    int choose_value(int variable, int best_violated) {
+        auto& variable_domain = domain(variable);
+        const int* row = &conflicts[offsets[variable]];
+        const long long* tabu = &tabu_until[offsets[variable]];
+        int current = values[variable];
+
+        if (std::uniform_real_distribution<double>(0, 1)(random) < settings.walk_probability) {
+            int n_others = variable_domain.size() - 1;
+            if (n_others <= 0) {
+                return -1;
+            }
+            int k = std::uniform_int_distribution<int>(0, n_others - 1)(random);
+            for (int x = variable_domain.first(); x != -1; x = variable_domain.next(x)) {
+                if (x != current && k-- == 0) {
+                    return x;
+                }
+            }
+        }
+
+        return fewest_conflicts(variable, [&](int x) {
+            bool aspiration = n_violated + row[x] - row[current] < best_violated;
+            return x != current && (tabu[x] <= n_steps || aspiration);
+        });
+    }
+
+    // Value of variable with the fewest conflicts among those allowed(x) accepts, ties broken at random. -1 when there
+    // is none.
+    template <typename Allowed>
+    int fewest_conflicts(int variable, Allowed allowed) {
+        auto& variable_domain = domain(variable);
+        const int* row = &conflicts[offsets[variable]];
+        int best = -1;
+        int n_ties = 0;
+        for (int x = variable_domain.first(); x != -1; x = variable_domain.next(x)) {
+            if (!allowed(x)) {
+                continue;
+            }
+            if (best == -1 || row[x] < row[best]) {
+                best = x;
+                n_ties = 1;
+            } else if (row[x] == row[best] && std::uniform_int_distribution<int>(0, n_ties++)(random) == 0) {
+                best = x;
+            }
+        }
+        return best;
+    }
+
+    // Greedy start from a random variable order, then moves of a random conflicted variable until no constraint is
+    // violated (true, the solution is in values), max_steps moves or stop
+    bool run(unsigned seed, const std::atomic<bool>& stop) {
+        TRACE_ZONE("CSP local search restart");
+        random.seed(seed);
+        int n_variables = problem.model_variables.size();
+        values.assign(n_variables, -1);
+        conflicts.assign(offsets[n_variables], 0);
+        tabu_until.assign(offsets[n_variables], 0);
+        conflicted.clear();
+        conflicted_position.assign(n_variables, -1);
+        n_steps = 0;
+
+        std::vector<int> order(n_variables);
+        for (int v = 0; v < n_variables; v++) {
+            order[v] = v;
+        }
+        std::shuffle(order.begin(), order.end(), random);
+        for (int v : order) {
+            int x = fewest_conflicts(v, [](int) { return true; });
+            if (x == -1) {
+                return false;
+            }
+            place(v, x);
+        }
+
+        n_violated = 0;
+        for (int c = 0; c < problem.model_constraints.size(); c++) {
+            n_violated += violated(c);
+        }
+        int best_violated = n_violated;
+        for (; n_steps < settings.max_steps; n_steps++) {
+            if (n_violated == 0) {
+                return true;
+            }
+            if (stop.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            int variable = conflicted[std::uniform_int_distribution<int>(0, conflicted.size() - 1)(random)];
+            int x = choose_value(variable, best_violated);
+            if (x == -1) {
+                continue;
+            }
+            tabu_until[offsets[variable] + values[variable]] = n_steps + settings.tabu_tenure;
+            move(variable, x);
+            best_violated = n_violated < best_violated ? n_violated : best_violated;
+        }
+        return n_violated == 0;
+    }
+};
+
+// Min-conflicts local search with tabu and random walk, over the variables and binary or other constraints of problem.
+// Runs settings.n_restarts restarts on settings.n_threads threads, and returns the first solution found, or an empty
+// vector when no restart finds one. Unlike the tree searches, an empty result does not prove there is no solution.
+// note: Global constraints are not supported. consistent() is called from several threads at once, like in
+// csp_search_parallel().
+template <typename Constraint = CSP_Constraint>
+std::vector<int> csp_min_conflicts(CSP& problem, const CSP_LocalSearchSettings& settings = {}) {
+    if (!problem.global_constraints.empty()) {
+        std::cerr << "Error : Local search does not support global constraints" << std::endl;
+        return {};
+    }
+    if (!problem.finalized()) {
+        problem.finalize();
+    }
+    int n_threads = settings.n_threads;
+    if (n_threads <= 0) {
+        n_threads = std::thread::hardware_concurrency();
+        n_threads = n_threads > 0 ? n_threads : 1;
+    }
+    n_threads = n_threads < settings.n_restarts ? n_threads : settings.n_restarts;
+
+    std::atomic<int> next_restart{0};
+    std::atomic<bool> stop{false};
+    std::mutex mutex;
+    std::vector<int> solution;
+    auto worker = [&]() {
+        CSP_MinConflicts<Constraint> search(problem, settings);
+        for (int r = next_restart++; r < settings.n_restarts && !stop; r = next_restart++) {
+            if (search.run(settings.seed + r, stop)) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!stop) {
+                    solution = search.values;
+                    stop = true;
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < n_threads; t++) {
+        workers.emplace_back(worker);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    return solution;
+}
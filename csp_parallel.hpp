@@ -0,0 +1,125 @@
+#pragma once
+#include "constraints_satisfaction_problem.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Open subtrees shared by the workers of csp_search_parallel()
+struct CSP_WorkPool {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<CSP_Subtree> subtrees; // Used as a stack, the deepest subtrees (usually the smallest) go first
+    int n_workers = 0;
+    int n_waiting = 0; // Workers without a subtree
+
+    // Read by busy workers without the lock, to decide whether to hand work over
+    std::atomic<int> n_hungry{0};
+    std::atomic<int> n_queued{0};
+    // Set once a solution is found or every worker waits on an empty pool, workers check it at every node
+    std::atomic<bool> stop{false};
+    std::vector<int> solution;
+
+    // Blocks until there is a subtree to search (true) or the search is over (false)
+    bool take(CSP_Subtree& subtree) {
+        std::unique_lock<std::mutex> lock(mutex);
+        n_waiting++;
+        n_hungry++;
+        if (n_waiting == n_workers && subtrees.empty()) {
+            // Nobody is left to hand work over, the tree is exhausted
+            stop = true;
+            changed.notify_all();
+        }
+        changed.wait(lock, [&] { return stop || !subtrees.empty(); });
+        n_waiting--;
+        n_hungry--;
+        if (stop) {
+            return false;
+        }
+        subtree = std::move(subtrees.back());
+        subtrees.pop_back();
+        n_queued--;
+        return true;
+    }
+
+    void give(CSP_Subtree&& subtree) {
+        std::lock_guard<std::mutex> lock(mutex);
+        subtrees.push_back(std::move(subtree));
+        n_queued++;
+        changed.notify_one();
+    }
+
+    // The first solution wins, the other workers stop at their next node
+    void finish(const std::vector<int>& found) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!stop) {
+            solution = found;
+            stop = true;
+        }
+        changed.notify_all();
+    }
+};
+
+// Every worker owns a CSP with its own domains, trail and ordering state, and reads the variables and constraints of
+// problem. While some worker waits for work, busy ones hand over the untried values of their shallowest open level,
+// along with the assignments leading there.
+template <typename Constraint = CSP_Constraint>
+void csp_parallel_worker(const CSP& problem, CSP_WorkPool& pool, CSP_Inference inference) {
+    CSP worker;
+    worker.borrow_model(problem);
+
+    CSP_Subtree subtree;
+    while (pool.take(subtree)) {
+        TRACE_ZONE("CSP subtree");
+        int level = worker.enter_subtree<Constraint>(subtree, inference);
+        if (level == -1) {
+            continue;
+        }
+        int n_nodes = 0;
+        bool found = worker.run_levels<Constraint>(inference, level, [&](int i) {
+            if (pool.stop.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            // note: Looking for an open level costs a scan of the levels above, so it is only done every few nodes
+            if ((++n_nodes & 15) == 0 && pool.n_hungry.load(std::memory_order_relaxed) > pool.n_queued.load(std::memory_order_relaxed)) {
+                CSP_Subtree open;
+                if (worker.donate(i, open)) {
+                    pool.give(std::move(open));
+                }
+            }
+            return true;
+        });
+        if (found) {
+            pool.finish(worker.result);
+        }
+    }
+}
+
+// Parallel version of CSP::backtrack() (inference none), backtrack_fc() and backtrack_mac(), with the orderings set on
+// problem. Returns the first solution any worker finds, which is not always the one the sequential search finds, or
+// an empty vector when there is none. n_threads = 0 uses every hardware thread.
+// note: consistent() of the constraints is called from several threads at once, it must not modify them.
+template <typename Constraint = CSP_Constraint>
+std::vector<int> csp_search_parallel(CSP& problem, CSP_Inference inference = CSP_Inference::forward_checking, int n_threads = 0) {
+    if (n_threads <= 0) {
+        n_threads = std::thread::hardware_concurrency();
+        n_threads = n_threads > 0 ? n_threads : 1;
+    }
+    if (!problem.finalized()) {
+        problem.finalize();
+    }
+
+    CSP_WorkPool pool;
+    pool.n_workers = n_threads;
+    pool.subtrees.push_back(CSP_Subtree());
+    pool.n_queued = 1;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < n_threads; t++) {
+        workers.emplace_back(csp_parallel_worker<Constraint>, std::cref(problem), std::ref(pool), inference);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return pool.solution;
+}
@@ -1,29 +1,65 @@
+#pragma once
 #include "blast_rush.h"
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
 
 using namespace blast;
 
-bool is_in_list(State state, std::vector<State> list);
-bool is_same_state(State state1, State state2);
+struct State;
+bool is_in_list(const State& state, const std::vector<State>& list);
+bool is_same_state(const State& state1, const State& state2);
 template <typename T>
-std::vector<T> flip(std::vector<T> v);
+std::vector<T> flip(const std::vector<T>& v);
 
 enum uninformed_search_type {
     DEPTH_FIRST,
-    BREADTH_FIRST
+    BREADTH_FIRST,
+    DEPTH_LIMITED,      // Depth first up to depth_limit edges, keeping only the current path
+    ITERATIVE_DEEPENING // Depth limited with limits 0, 1, ... up to depth_limit, finds a path with the fewest edges
+};
+
+enum shortest_path_type {
+    DIJKSTRA,
+    A_STAR,
+    RADIX_DIJKSTRA // Dijkstra for integer weights, with a radix heap
 };
 
 struct State {
     int idx;
 
+    // note: Example states, to replace with those of the problem: 1 -> 2, 3 ; 2 -> 4 ; 3 -> 4, 5 ; 4 is a dead end ;
+    // 5 -> 1 ; 6 -> 1 and nothing reaches 6
     std::vector<State> get_reachable_states() {
+        std::vector<State> result;
         switch (idx) {
-            case 1: 
-
+            case 1:
+                result = {State{2}, State{3}};
+                break;
+            case 2:
+                result = {State{4}};
+                break;
+            case 3:
+                result = {State{4}, State{5}};
+                break;
+            case 4:
+                break;
+            case 5:
+            case 6:
+                result = {State{1}};
                 break;
             default:
                 std::cerr << "Error : idx is not valid" << std::endl;
                 break;
         }
+        return result;
     }
 };
 
@@ -33,88 +69,421 @@ struct Node {
     float path_cost = 0;
 };
 
+struct Edge {
+    int from;
+    int to;
+    float weight = 1;
+};
+
+// Directed graph in compressed sparse row form: the edges leaving vertex v go to targets[offsets[v]] ..
+// targets[offsets[v+1] - 1], and weights holds their costs at the same positions
+struct Graph {
+    std::vector<int> offsets = {0};
+    std::vector<int> targets;
+    std::vector<float> weights;
+
+    int n_vertices() const { return offsets.size() - 1; }
+    int n_edges() const { return targets.size(); }
+    int degree(int v) const { return offsets[v+1] - offsets[v]; }
+};
+
+// Builds the graph with a counting sort of the edges by source, edges of a vertex keep their order in the list.
+// With undirected, every edge also goes the other way.
+inline Graph graph_from_edges(int n_vertices, const std::vector<Edge>& edges, bool undirected = false) {
+    Graph graph;
+    graph.offsets.assign(n_vertices + 1, 0);
+    for (const auto& edge : edges) {
+        if (edge.from < 0 || edge.from >= n_vertices || edge.to < 0 || edge.to >= n_vertices) {
+            std::cerr << "Error : Edge from " << edge.from << " to " << edge.to << " has a vertex out of range" << std::endl;
+            continue;
+        }
+        graph.offsets[edge.from + 1]++;
+        if (undirected) {
+            graph.offsets[edge.to + 1]++;
+        }
+    }
+    for (int v = 0; v < n_vertices; v++) {
+        graph.offsets[v+1] += graph.offsets[v];
+    }
+    graph.targets.resize(graph.offsets[n_vertices]);
+    graph.weights.resize(graph.offsets[n_vertices]);
+
+    std::vector<int> next(graph.offsets.begin(), graph.offsets.end() - 1);
+    auto add = [&](int from, int to, float weight) {
+        graph.targets[next[from]] = to;
+        graph.weights[next[from]] = weight;
+        next[from]++;
+    };
+    for (const auto& edge : edges) {
+        if (edge.from < 0 || edge.from >= n_vertices || edge.to < 0 || edge.to >= n_vertices) {
+            continue;
+        }
+        add(edge.from, edge.to, edge.weight);
+        if (undirected) {
+            add(edge.to, edge.from, edge.weight);
+        }
+    }
+    return graph;
+}
+
+// Text edge list, one "from to [weight]" edge per line (weight 1 when omitted), lines starting with # are skipped.
+// Vertices are numbered from 0 up to the largest index in the file.
+inline bool load_edge_list(const std::string& path, Graph& graph, bool undirected = false) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Error : Could not open " << path << " for reading" << std::endl;
+        return false;
+    }
+    std::vector<Edge> edges;
+    int n_vertices = 0;
+    std::string line;
+    for (int line_number = 1; std::getline(file, line); line_number++) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        Edge edge;
+        if (!(fields >> edge.from >> edge.to) || edge.from < 0 || edge.to < 0) {
+            std::cerr << "Error : " << path << " line " << line_number << " is not an edge" << std::endl;
+            return false;
+        }
+        if (!(fields >> edge.weight)) {
+            edge.weight = 1;
+        }
+        n_vertices = edge.from >= n_vertices ? edge.from + 1 : n_vertices;
+        n_vertices = edge.to >= n_vertices ? edge.to + 1 : n_vertices;
+        edges.push_back(edge);
+    }
+    graph = graph_from_edges(n_vertices, edges, undirected);
+    return true;
+}
+
+// Same vertices with every edge turned around
+inline Graph reversed(const Graph& graph) {
+    std::vector<Edge> edges;
+    edges.reserve(graph.n_edges());
+    for (int v = 0; v < graph.n_vertices(); v++) {
+        for (int e = graph.offsets[v]; e < graph.offsets[v+1]; e++) {
+            edges.push_back({graph.targets[e], v, graph.weights[e]});
+        }
+    }
+    return graph_from_edges(graph.n_vertices(), edges);
+}
+
+// Double ended queue in one growing circular buffer, used as a FIFO by breadth first search and as a stack by depth
+// first search
+template <typename T>
+struct RingBuffer {
+    std::vector<T> items;
+    size_t head = 0; // Position of the front item
+    size_t count = 0;
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    void clear() { head = 0; count = 0; }
+
+    T& front() { return items[head]; }
+    T& back() { return items[(head + count - 1) & (items.size() - 1)]; }
+
+    void push_back(const T& item) {
+        if (count == items.size()) {
+            grow();
+        }
+        items[(head + count) & (items.size() - 1)] = item;
+        count++;
+    }
+
+    T pop_front() {
+        T item = items[head];
+        head = (head + 1) & (items.size() - 1);
+        count--;
+        return item;
+    }
+
+    T pop_back() {
+        T item = back();
+        count--;
+        return item;
+    }
+
+    private:
+        // Capacity stays a power of two so that positions wrap with a mask
+        void grow() {
+            std::vector<T> new_items(items.empty() ? 16 : 2*items.size());
+            for (size_t i = 0; i < count; i++) {
+                new_items[i] = items[(head + i) & (items.size() - 1)];
+            }
+            items = std::move(new_items);
+            head = 0;
+        }
+};
+
+// Current state of DEPTH_LIMITED and ITERATIVE_DEEPENING searches at one depth: the state and the next of its successors
+// to try, either an edge of the graph or an element of successors when there is no graph
+struct PathFrame {
+    State state;
+    int next = 0;
+    std::vector<State> successors;
+};
+
+// Entry of the transposition table of UninformedSearch: state idx was reached at depth during a pass
+struct TranspositionEntry {
+    int idx = -1;
+    int depth = 0;
+    long long pass = 0;
+};
+
+// Searches graph when it is set, with its edge weights as costs. Otherwise states are expanded with
+// State::get_reachable_states() and costs.
 struct UninformedSearch {
-    std::vector<Node> search_queue;
-    std::vector<State> visited_states;
+    std::deque<Node> nodes;          // Every node of the search, a deque so that parent pointers stay valid
+    RingBuffer<Node*> search_queue;  // Nodes generated but not expanded yet
+    std::vector<uint64_t> visited;   // Bit idx is set once a node of state idx was generated
+    const Graph* graph = nullptr;
     Matrix costs; // cost to go from <row> to <col>
 
     uninformed_search_type search_type = uninformed_search_type::DEPTH_FIRST;
     bool use_visited_list = true;
 
-    void initialize_search(Node start_node) {
-        search_queue.clear();
-        search_queue.resize(1);
-        search_queue[0] = start_node;
+    // DEPTH_LIMITED and ITERATIVE_DEEPENING only keep the current path, and skip the states already on it. Memory is
+    // O(depth_limit) plus the transposition table, whatever the size of the graph.
+    int depth_limit = 1000;
+    // Entries remembering the shallowest depth states were reached at during the current pass, so that a state reached
+    // again as deep or deeper is not searched twice. Colliding states replace each other. 0 for none.
+    int transposition_table_size = 0;
+    std::vector<PathFrame> path;
+    int path_depth = 0; // Frames in use in path, the others keep their memory for later passes
+    std::vector<TranspositionEntry> transposition_table;
+    long long pass = 0;
+    long long n_expanded = 0;
+
+    bool is_visited(int idx) const {
+        size_t word = idx / 64;
+        return word < visited.size() && (visited[word] >> (idx % 64)) & 1;
+    }
 
-        visited_states.clear();
-        visited_states.resize(1);
-        visited_states[0] = start_node.state;
+    void mark_visited(int idx) {
+        size_t word = idx / 64;
+        if (word >= visited.size()) {
+            visited.resize(2*word + 1, 0);
+        }
+        visited[word] |= uint64_t(1) << (idx % 64);
+    }
+
+    Node* add_node(Node* parent, const State& state, float path_cost) {
+        Node new_node;
+        new_node.parent = parent;
+        new_node.state = state;
+        new_node.path_cost = path_cost;
+        nodes.push_back(new_node);
+        if (use_visited_list) {
+            mark_visited(state.idx);
+        }
+        return &nodes.back();
     }
 
-    std::vector<Node> get_extended_paths(Node node) {
-        auto possible_states = node.state.get_reachable_states();
-        std::vector<Node> result;
-        result.reserve(possible_states.size());
-        for (auto state : possible_states) {
-            if (!use_visited_list || !is_in_list(state, visited_states)) {
-                Node new_node;
-                new_node.parent = &node;
-                new_node.path_cost = node.path_cost + costs(node.state.idx, state.idx);
-                new_node.state = state;
-                result.push_back(new_node);
+    void initialize_search(const State& start) {
+        nodes.clear();
+        search_queue.clear();
+        for (auto& word : visited) {
+            word = 0;
+        }
+        if (graph) {
+            visited.resize((graph->n_vertices() + 63) / 64, 0);
+        }
+        search_queue.push_back(add_node(nullptr, start, 0));
+    }
+
+    // Applies f(child) to a new node for each successor of node not visited yet, last successor first when reversed
+    template <typename F>
+    void extend(Node* node, bool reversed, F f) {
+        int idx = node->state.idx;
+        if (graph) {
+            int begin = graph->offsets[idx];
+            int end = graph->offsets[idx+1];
+            for (int k = 0; k < end - begin; k++) {
+                int e = reversed ? end - 1 - k : begin + k;
+                int target = graph->targets[e];
+                if (!use_visited_list || !is_visited(target)) {
+                    f(add_node(node, State{target}, node->path_cost + graph->weights[e]));
+                }
+            }
+            return;
+        }
+        auto possible_states = node->state.get_reachable_states();
+        for (int k = 0; k < possible_states.size(); k++) {
+            const auto& state = possible_states[reversed ? possible_states.size() - 1 - k : k];
+            if (!use_visited_list || !is_visited(state.idx)) {
+                f(add_node(node, state, node->path_cost + costs(idx, state.idx)));
             }
         }
+    }
+
+    std::vector<Node*> get_extended_paths(Node* node) {
+        std::vector<Node*> result;
+        extend(node, false, [&](Node* child) { result.push_back(child); });
         return result;
     }
 
-    void depth_first(State end) {
-        bool found_path = false;
-        while (!found_path) {
-            if (is_same_state(search_queue[search_queue.size()-1].state, end)) {
-                found_path = true;
-                break;
+    // Returns the node reaching end, nullptr when there is none
+    Node* depth_first(const State& end) {
+        while (!search_queue.empty()) {
+            Node* node = search_queue.pop_back();
+            if (is_same_state(node->state, end)) {
+                return node;
             }
-            auto next_nodes = get_extended_paths(search_queue[search_queue.size()-1]);
+            // First reachable state on top of the stack
+            extend(node, true, [&](Node* child) { search_queue.push_back(child); });
+        }
+        return nullptr;
+    }
+
+    Node* breadth_first(const State& end) {
+        if (is_same_state(search_queue.front()->state, end)) {
+            return search_queue.front();
+        }
+        Node* found = nullptr;
+        while (!search_queue.empty() && !found) {
+            extend(search_queue.pop_front(), false, [&](Node* child) {
+                if (is_same_state(child->state, end)) {
+                    found = child;
+                }
+                search_queue.push_back(child);
+            });
+        }
+        return found;
+    }
 
-            next_nodes = flip(next_nodes);
+    // Next successor of the frame on top of path, false when there is none left
+    bool next_successor(PathFrame& frame, State& next) {
+        if (graph) {
+            int e = graph->offsets[frame.state.idx] + frame.next;
+            if (e >= graph->offsets[frame.state.idx + 1]) {
+                return false;
+            }
+            frame.next++;
+            next.idx = graph->targets[e];
+            return true;
+        }
+        if (frame.next >= frame.successors.size()) {
+            return false;
+        }
+        next = frame.successors[frame.next++];
+        return true;
+    }
+
+    void push_frame(const State& state) {
+        if (path_depth == path.size()) {
+            path.emplace_back();
+        }
+        auto& frame = path[path_depth++];
+        frame.state = state;
+        frame.next = 0;
+        if (!graph) {
+            frame.successors = frame.state.get_reachable_states();
+        }
+    }
 
-            for (auto node : next_nodes) {
-                search_queue.push_back(node);
-                visited_states.push_back(node.state);
+    bool is_on_path(const State& state) const {
+        for (int d = 0; d < path_depth; d++) {
+            if (is_same_state(path[d].state, state)) {
+                return true;
             }
         }
+        return false;
     }
 
-    void breadth_first(State end) {
-        bool found_path = false;
-        while (!found_path) {
-            auto next_nodes = get_extended_paths(search_queue[0]);
+    // False when state was already reached at depth or shallower in this pass, otherwise remembers it
+    bool transposition_admits(const State& state, int depth) {
+        if (transposition_table_size <= 0) {
+            return true;
+        }
+        if (transposition_table.size() != transposition_table_size) {
+            transposition_table.assign(transposition_table_size, TranspositionEntry());
+        }
+        auto& entry = transposition_table[((uint64_t)(uint32_t)state.idx * 0x9e3779b97f4a7c15ULL >> 32) % transposition_table_size];
+        if (entry.idx == state.idx && entry.pass == pass && entry.depth <= depth) {
+            return false;
+        }
+        entry = {state.idx, depth, pass};
+        return true;
+    }
 
-            for (auto node : next_nodes) {
-                search_queue.push_back(node);
-                visited_states.push_back(node.state);
+    // Depth first search from start along paths of at most limit edges. True when end was reached, path then holds the
+    // states from start to end. cut_off tells whether some path was stopped by the limit.
+    bool depth_limited(const State& start, const State& end, int limit, bool& cut_off) {
+        pass++;
+        path_depth = 0;
+        cut_off = false;
+        push_frame(start);
+        transposition_admits(start, 0);
+        if (is_same_state(start, end)) {
+            return true;
+        }
+        State next;
+        while (path_depth > 0) {
+            auto& frame = path[path_depth - 1];
+            if (frame.next == 0) {
+                n_expanded++;
+            }
+            if (!next_successor(frame, next)) {
+                path_depth--;
+                continue;
+            }
+            if (path_depth > limit) {
+                // The successors of the frame are one edge too deep
+                cut_off = true;
+                path_depth--;
+                continue;
+            }
+            if (is_on_path(next) || !transposition_admits(next, path_depth)) {
+                continue;
+            }
+            push_frame(next);
+            if (is_same_state(next, end)) {
+                return true;
+            }
+        }
+        return false;
+    }
 
-                if (is_same_state(node.state, end)) {
-                    found_path = true;
-                    break;
-                }
+    // Depth limited searches with limits 0 to depth_limit, stops early once a pass explored everything reachable
+    bool iterative_deepening(const State& start, const State& end) {
+        for (int limit = 0; limit <= depth_limit; limit++) {
+            bool cut_off = false;
+            if (depth_limited(start, end, limit, cut_off)) {
+                return true;
+            }
+            if (!cut_off) {
+                return false;
             }
         }
+        return false;
     }
 
+    // States from start to end, empty when end cannot be reached
     std::vector<State> search(State start, State end) {
-        Node start_node;
-        start_node.path_cost = 0;
-        start_node.state = start;
+        if (search_type == uninformed_search_type::DEPTH_LIMITED || search_type == uninformed_search_type::ITERATIVE_DEEPENING) {
+            n_expanded = 0;
+            bool cut_off = false;
+            bool found = search_type == uninformed_search_type::DEPTH_LIMITED ? depth_limited(start, end, depth_limit, cut_off)
+                                                                                : iterative_deepening(start, end);
+            std::vector<State> result;
+            for (int d = 0; found && d < path_depth; d++) {
+                result.push_back(path[d].state);
+            }
+            return result;
+        }
 
-        initialize_search(start_node);
+        initialize_search(start);
 
+        Node* end_node = nullptr;
         switch (search_type) {
             case uninformed_search_type::DEPTH_FIRST:
-                depth_first(end);
+                end_node = depth_first(end);
                 break;
             case uninformed_search_type::BREADTH_FIRST:
-                breadth_first(end);
+                end_node = breadth_first(end);
                 break;
             default:
                 std::cerr << "Error : Wrong search type" << std::endl;
@@ -122,23 +491,463 @@ struct UninformedSearch {
         }
 
         std::vector<State> result;
-        auto current_node = search_queue.back();
-        while (true) {
-            if (is_same_state(current_node.state, start)) {
-                result.push_back(start);
+        for (auto node = end_node; node != nullptr; node = node->parent) {
+            result.push_back(node->state);
+        }
+        return flip(result);
+    }
+};
+
+// Binary min-heap of vertices keyed by their cost, position[v] locates vertex v in items (-1 when it is not in the heap)
+// so that decrease_key() is O(log n)
+struct IndexedHeap {
+    std::vector<int> items;
+    std::vector<float> keys; // Per vertex
+    std::vector<int> position;
+
+    bool empty() const { return items.empty(); }
+    bool contains(int v) const { return position[v] != -1; }
+
+    // Adds vertex n_vertices, for graphs that grow during the search
+    void add_vertex() {
+        position.push_back(-1);
+        keys.push_back(0);
+    }
+
+    // Empties the heap for vertices 0 to n_vertices - 1, only the vertices left in the heap are touched when the size
+    // does not change
+    void reset(int n_vertices) {
+        if (position.size() != n_vertices) {
+            position.assign(n_vertices, -1);
+            keys.resize(n_vertices);
+        } else {
+            for (int v : items) {
+                position[v] = -1;
+            }
+        }
+        items.clear();
+    }
+
+    void push(int v, float key) {
+        keys[v] = key;
+        position[v] = items.size();
+        items.push_back(v);
+        sift_up(position[v]);
+    }
+
+    void decrease_key(int v, float key) {
+        keys[v] = key;
+        sift_up(position[v]);
+    }
+
+    int pop() {
+        int top = items[0];
+        position[top] = -1;
+        int last = items.back();
+        items.pop_back();
+        if (!items.empty()) {
+            items[0] = last;
+            position[last] = 0;
+            sift_down(0);
+        }
+        return top;
+    }
+
+    private:
+        void sift_up(int i) {
+            int v = items[i];
+            while (i > 0) {
+                int up = (i - 1) / 2;
+                if (keys[items[up]] <= keys[v]) {
+                    break;
+                }
+                items[i] = items[up];
+                position[items[i]] = i;
+                i = up;
+            }
+            items[i] = v;
+            position[v] = i;
+        }
+
+        void sift_down(int i) {
+            int v = items[i];
+            int n = items.size();
+            while (2*i + 1 < n) {
+                int child = 2*i + 1;
+                if (child + 1 < n && keys[items[child + 1]] < keys[items[child]]) {
+                    child++;
+                }
+                if (keys[v] <= keys[items[child]]) {
+                    break;
+                }
+                items[i] = items[child];
+                position[items[i]] = i;
+                i = child;
+            }
+            items[i] = v;
+            position[v] = i;
+        }
+};
+
+// Monotone priority queue of integer keys: no key pushed is below the last key popped. Bucket b > 0 holds the keys whose
+// highest bit differing from the last key popped is bit b - 1, so that every key is moved down at most 32 times.
+struct RadixHeap {
+    std::vector<std::pair<uint32_t, int>> buckets[33]; // (key, vertex)
+    uint32_t last = 0;
+    size_t count = 0;
+
+    bool empty() const { return count == 0; }
+
+    void clear() {
+        for (auto& bucket : buckets) {
+            bucket.clear();
+        }
+        last = 0;
+        count = 0;
+    }
+
+    void push(uint32_t key, int v) {
+        buckets[bucket_of(key)].push_back({key, v});
+        count++;
+    }
+
+    std::pair<uint32_t, int> pop() {
+        if (buckets[0].empty()) {
+            int b = 1;
+            while (buckets[b].empty()) {
+                b++;
+            }
+            last = buckets[b][0].first;
+            for (const auto& item : buckets[b]) {
+                last = item.first < last ? item.first : last;
+            }
+            for (const auto& item : buckets[b]) {
+                buckets[bucket_of(item.first)].push_back(item);
+            }
+            buckets[b].clear();
+        }
+        auto item = buckets[0].back();
+        buckets[0].pop_back();
+        count--;
+        return item;
+    }
+
+    private:
+        int bucket_of(uint32_t key) const {
+            uint32_t diff = key ^ last;
+            if (diff == 0) {
+                return 0;
+            }
+#if defined(_MSC_VER)
+            unsigned long bit;
+            _BitScanReverse(&bit, diff);
+            return bit + 1;
+#else
+            return 32 - __builtin_clz(diff);
+#endif
+        }
+};
+
+// Weighted shortest paths over a Graph. The search tree is kept as one parent index per vertex instead of nodes, so a
+// search allocates nothing once the arrays have the size of the graph.
+struct ShortestPathSearch {
+    const Graph* graph = nullptr;
+    shortest_path_type search_type = shortest_path_type::DIJKSTRA;
+    std::function<float(int)> heuristic; // Lower bound of the cost from a vertex to the end, used by A_STAR
+
+    std::vector<float> distance; // Cost of the best path found from start, infinity when the vertex was not reached
+    std::vector<int> parent;     // Previous vertex on that path, -1 for start and vertices not reached
+    IndexedHeap open;
+    RadixHeap radix_open;
+    int n_expanded = 0;
+
+    void initialize_search(int start) {
+        int n_vertices = graph->n_vertices();
+        distance.assign(n_vertices, std::numeric_limits<float>::infinity());
+        parent.assign(n_vertices, -1);
+        distance[start] = 0;
+        n_expanded = 0;
+    }
+
+    // A* from start until end is expanded, true when it is reachable. With a consistent heuristic (h(u) <= w(u, v) +
+    // h(v)) each vertex is expanded once, an admissible one reopens vertices whose cost improves and still finds the
+    // optimum. Dijkstra is A* with h = 0.
+    template <typename Heuristic>
+    bool a_star(int start, int end, Heuristic h) {
+        initialize_search(start);
+        open.reset(graph->n_vertices());
+        open.push(start, h(start));
+        while (!open.empty()) {
+            int u = open.pop();
+            if (u == end) {
+                return true;
+            }
+            n_expanded++;
+            for (int e = graph->offsets[u]; e < graph->offsets[u+1]; e++) {
+                int v = graph->targets[e];
+                float cost = distance[u] + graph->weights[e];
+                if (cost < distance[v]) {
+                    distance[v] = cost;
+                    parent[v] = u;
+                    if (open.contains(v)) {
+                        open.decrease_key(v, cost + h(v));
+                    } else {
+                        open.push(v, cost + h(v));
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    bool dijkstra(int start, int end) {
+        return a_star(start, end, [](int) { return 0.f; });
+    }
+
+    // Dijkstra with a radix heap, for weights that are nonnegative integers. Stale entries stay in the heap and are
+    // skipped when popped, which is cheaper than a decrease key there.
+    // note: Distances are stored as float, they are exact up to 2^24.
+    bool radix_dijkstra(int start, int end) {
+        initialize_search(start);
+        radix_open.clear();
+        radix_open.push(0, start);
+        while (!radix_open.empty()) {
+            auto item = radix_open.pop();
+            int u = item.second;
+            if (item.first > distance[u]) {
+                continue;
+            }
+            if (u == end) {
+                return true;
+            }
+            n_expanded++;
+            for (int e = graph->offsets[u]; e < graph->offsets[u+1]; e++) {
+                float weight = graph->weights[e];
+                if (weight < 0 || weight != (float)(uint32_t)weight) {
+                    std::cerr << "Error : Radix Dijkstra requires nonnegative integer weights" << std::endl;
+                    return false;
+                }
+                int v = graph->targets[e];
+                float cost = distance[u] + weight;
+                if (cost < distance[v]) {
+                    distance[v] = cost;
+                    parent[v] = u;
+                    radix_open.push((uint32_t)cost, v);
+                }
+            }
+        }
+        return false;
+    }
+
+    // Vertices from the start of the last search to end, empty when end was not reached
+    std::vector<int> path(int end) const {
+        std::vector<int> result;
+        if (distance[end] == std::numeric_limits<float>::infinity()) {
+            return result;
+        }
+        for (int v = end; v != -1; v = parent[v]) {
+            result.push_back(v);
+        }
+        return flip(result);
+    }
+
+    // States from start to end along a path of minimum cost, empty when end cannot be reached
+    std::vector<State> search(State start, State end) {
+        bool found = false;
+        switch (search_type) {
+            case shortest_path_type::DIJKSTRA:
+                found = dijkstra(start.idx, end.idx);
+                break;
+            case shortest_path_type::A_STAR:
+                if (!heuristic) {
+                    std::cerr << "Error : A_STAR requires a heuristic" << std::endl;
+                    return {};
+                }
+                found = a_star(start.idx, end.idx, heuristic);
+                break;
+            case shortest_path_type::RADIX_DIJKSTRA:
+                found = radix_dijkstra(start.idx, end.idx);
+                break;
+            default:
+                std::cerr << "Error : Wrong search type" << std::endl;
                 break;
-            } else {
-                result.push_back(current_node.state);
-                current_node = *current_node.parent;
+        }
+
+        std::vector<State> result;
+        if (found) {
+            for (int v : path(end.idx)) {
+                result.push_back(State{v});
             }
         }
+        return result;
+    }
+};
+
+// State of one RoadmapQueries::query() at a time, each thread querying needs its own. The distance and parent of a vertex
+// only hold for the current query when its stamp is the current generation, so a query starts without clearing them.
+struct QueryBuffers {
+    std::vector<float> distance;
+    std::vector<int> parent;
+    std::vector<uint32_t> stamp;
+    uint32_t generation = 0;
+    IndexedHeap open;
+    int n_expanded = 0;
+
+    void start_query(int n_vertices) {
+        if (stamp.size() != n_vertices) {
+            distance.resize(n_vertices);
+            parent.resize(n_vertices);
+            stamp.assign(n_vertices, 0);
+            generation = 0;
+        }
+        generation++;
+        if (generation == 0) {
+            // Wrapped around, old stamps could look current
+            std::fill(stamp.begin(), stamp.end(), 0);
+            generation = 1;
+        }
+        open.reset(n_vertices);
+        n_expanded = 0;
+    }
+
+    float distance_of(int v) const {
+        return stamp[v] == generation ? distance[v] : std::numeric_limits<float>::infinity();
+    }
 
+    void set(int v, float cost, int from) {
+        stamp[v] = generation;
+        distance[v] = cost;
+        parent[v] = from;
+    }
+};
+
+// Shortest path queries on a static graph, with A* guided by landmarks (ALT). preprocess() picks landmarks spread over
+// the graph and stores the distances from and to each of them. By the triangle inequality d(v, end) is at least
+// d(l, end) - d(l, v) and d(v, l) - d(end, l) for every landmark l, which bounds the cost to go much tighter than a
+// geometric heuristic on roadmaps. query() only reads the engine, so threads can share it with one QueryBuffers each.
+struct RoadmapQueries {
+    const Graph* graph = nullptr;
+    int n_landmarks = 0;
+    std::vector<int> landmarks;
+    // [v*n_landmarks + l] is the distance from (to) landmark l to (from) v, the landmarks of a vertex are contiguous
+    std::vector<float> from_landmark;
+    std::vector<float> to_landmark;
+
+    // Farthest point selection: the first landmark is first_landmark, the next ones are the vertices farthest from the
+    // landmarks chosen so far, vertices that none of them reaches first
+    void preprocess(const Graph& new_graph, int new_n_landmarks, int first_landmark = 0) {
+        graph = &new_graph;
+        int n_vertices = graph->n_vertices();
+        n_landmarks = new_n_landmarks < n_vertices ? new_n_landmarks : n_vertices;
+        landmarks.clear();
+        from_landmark.assign((size_t)n_vertices*n_landmarks, 0);
+        to_landmark.assign((size_t)n_vertices*n_landmarks, 0);
+        if (n_landmarks == 0) {
+            return;
+        }
+
+        Graph reverse = reversed(*graph);
+        ShortestPathSearch forward_search;
+        forward_search.graph = graph;
+        ShortestPathSearch backward_search;
+        backward_search.graph = &reverse;
+        const float infinity = std::numeric_limits<float>::infinity();
+        std::vector<float> nearest(n_vertices, infinity); // Distance from the closest landmark chosen so far
+
+        int landmark = first_landmark;
+        for (int l = 0; l < n_landmarks; l++) {
+            landmarks.push_back(landmark);
+            // An end of -1 is never reached, every vertex reachable gets its distance
+            forward_search.dijkstra(landmark, -1);
+            backward_search.dijkstra(landmark, -1);
+            for (int v = 0; v < n_vertices; v++) {
+                from_landmark[(size_t)v*n_landmarks + l] = forward_search.distance[v];
+                to_landmark[(size_t)v*n_landmarks + l] = backward_search.distance[v];
+                nearest[v] = forward_search.distance[v] < nearest[v] ? forward_search.distance[v] : nearest[v];
+            }
+            int farthest = -1;
+            for (int v = 0; v < n_vertices; v++) {
+                if (nearest[v] > 0 && (farthest == -1 || nearest[v] > nearest[farthest])) {
+                    farthest = v;
+                }
+            }
+            // note: When every vertex is at distance 0 from a landmark, the last one is repeated, which adds nothing
+            // to the heuristic but keeps the layout
+            landmark = farthest != -1 ? farthest : landmark;
+        }
+    }
+
+    // Lower bound of the cost from v to end. Landmarks that cannot reach both vertices, or that both cannot reach,
+    // give no bound.
+    float heuristic(int v, int end) const {
+        const float* from_v = &from_landmark[(size_t)v*n_landmarks];
+        const float* from_end = &from_landmark[(size_t)end*n_landmarks];
+        const float* to_v = &to_landmark[(size_t)v*n_landmarks];
+        const float* to_end = &to_landmark[(size_t)end*n_landmarks];
+        const float infinity = std::numeric_limits<float>::infinity();
+        float bound = 0;
+        for (int l = 0; l < n_landmarks; l++) {
+            if (from_v[l] != infinity && from_end[l] != infinity) {
+                float forward = from_end[l] - from_v[l];
+                bound = forward > bound ? forward : bound;
+            }
+            if (to_v[l] != infinity && to_end[l] != infinity) {
+                float backward = to_v[l] - to_end[l];
+                bound = backward > bound ? backward : bound;
+            }
+        }
+        return bound;
+    }
+
+    // A* from start to end with the landmark heuristic, true when end is reachable. The cost is then
+    // buffers.distance_of(end) and path() gives the vertices.
+    bool query(int start, int end, QueryBuffers& buffers) const {
+        int n_vertices = graph->n_vertices();
+        if (start < 0 || start >= n_vertices || end < 0 || end >= n_vertices) {
+            std::cerr << "Error : Query from " << start << " to " << end << " has a vertex out of range" << std::endl;
+            return false;
+        }
+        buffers.start_query(n_vertices);
+        buffers.set(start, 0, -1);
+        buffers.open.push(start, heuristic(start, end));
+        while (!buffers.open.empty()) {
+            int u = buffers.open.pop();
+            if (u == end) {
+                return true;
+            }
+            buffers.n_expanded++;
+            float distance_u = buffers.distance[u];
+            for (int e = graph->offsets[u]; e < graph->offsets[u+1]; e++) {
+                int v = graph->targets[e];
+                float cost = distance_u + graph->weights[e];
+                if (cost < buffers.distance_of(v)) {
+                    buffers.set(v, cost, u);
+                    if (buffers.open.contains(v)) {
+                        buffers.open.decrease_key(v, cost + heuristic(v, end));
+                    } else {
+                        buffers.open.push(v, cost + heuristic(v, end));
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    // Vertices from start to end after query() found end with these buffers
+    std::vector<int> path(int end, const QueryBuffers& buffers) const {
+        std::vector<int> result;
+        if (buffers.distance_of(end) == std::numeric_limits<float>::infinity()) {
+            return result;
+        }
+        for (int v = end; v != -1; v = buffers.parent[v]) {
+            result.push_back(v);
+        }
         return flip(result);
     }
 };
 
-bool is_in_list(State state, std::vector<State> list) {
-    for (auto element : list) {
+inline bool is_in_list(const State& state, const std::vector<State>& list) {
+    for (const auto& element : list) {
         if (state.idx == element.idx) {
             return true;
         }
@@ -146,7 +955,7 @@ bool is_in_list(State state, std::vector<State> list) {
     return false;
 }
 
-bool is_same_state(State state1, State state2) {
+inline bool is_same_state(const State& state1, const State& state2) {
     if (state1.idx != state2.idx) {
         return false;
     }
@@ -154,10 +963,11 @@ bool is_same_state(State state1, State state2) {
 }
 
 template <typename T>
-std::vector<T> flip(std::vector<T> v) {
+std::vector<T> flip(const std::vector<T>& v) {
     std::vector<T> results;
     results.reserve(v.size());
-    for (int i = v.size() - 1; i >= 0; v++) {
+    for (int i = v.size() - 1; i >= 0; i--) {
         results.push_back(v[i]);
     }
-}
\ No newline at end of file
+    return results;
+}
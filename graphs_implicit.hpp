@@ -0,0 +1,220 @@
+#pragma once
+#include "graphs.hpp"
+#include <functional>
+
+// Mixes the hash of one more field into seed, for hash functors of composite states
+inline size_t hash_combine(size_t seed, size_t value) {
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+// Hash of a state made of a vector of values, e.g. a discretized joint configuration
+struct VectorHash {
+    template <typename T>
+    size_t operator()(const std::vector<T>& values) const {
+        size_t seed = values.size();
+        for (const auto& value : values) {
+            seed = hash_combine(seed, std::hash<T>()(value));
+        }
+        return seed;
+    }
+};
+
+// States numbered in the order they are added, with an open addressing hash index so that finding a state costs one
+// hash and a few probes instead of a scan of the list. States are stored in a deque, which keeps references to them valid
+// while more are added.
+template <typename S, typename Hash = std::hash<S>, typename Equal = std::equal_to<S>>
+struct StateTable {
+    std::deque<S> states;
+    std::vector<uint64_t> hashes; // Mixed hash per state, so that growing the index does not hash again
+    std::vector<int> slots;     // State ids, -1 for empty slots. Size is a power of two, at most half full.
+    Hash hash;
+    Equal equal;
+
+    StateTable(Hash new_hash = Hash(), Equal new_equal = Equal()) : hash(new_hash), equal(new_equal) {
+        slots.assign(16, -1);
+    }
+
+    int size() const { return states.size(); }
+    const S& operator[](int id) const { return states[id]; }
+
+    void clear() {
+        states.clear();
+        hashes.clear();
+        std::fill(slots.begin(), slots.end(), -1);
+    }
+
+    // Id of state, -1 when it is not in the table
+    int find(const S& state) const {
+        uint64_t h = mix(hash(state));
+        for (size_t slot = h & (slots.size() - 1); slots[slot] != -1; slot = (slot + 1) & (slots.size() - 1)) {
+            int id = slots[slot];
+            if (hashes[id] == h && equal(states[id], state)) {
+                return id;
+            }
+        }
+        return -1;
+    }
+
+    // Id of state and whether it was added
+    std::pair<int, bool> insert(const S& state) {
+        uint64_t h = mix(hash(state));
+        size_t slot = h & (slots.size() - 1);
+        for (; slots[slot] != -1; slot = (slot + 1) & (slots.size() - 1)) {
+            int id = slots[slot];
+            if (hashes[id] == h && equal(states[id], state)) {
+                return {id, false};
+            }
+        }
+        int id = states.size();
+        states.push_back(state);
+        hashes.push_back(h);
+        slots[slot] = id;
+        if (2*states.size() > slots.size()) {
+            grow();
+        }
+        return {id, true};
+    }
+
+    private:
+        // note: std::hash of integers is often the identity, and the slot only uses the low bits, so they are mixed
+        // first (splitmix64 finalizer) or nearby states would pile up in long probe chains
+        static uint64_t mix(uint64_t h) {
+            h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+            return h ^ (h >> 31);
+        }
+
+        void grow() {
+            slots.assign(2*slots.size(), -1);
+            for (int id = 0; id < states.size(); id++) {
+                size_t slot = hashes[id] & (slots.size() - 1);
+                while (slots[slot] != -1) {
+                    slot = (slot + 1) & (slots.size() - 1);
+                }
+                slots[slot] = id;
+            }
+        }
+};
+
+// Search over states generated on demand: successors(state, emit) calls emit(next_state, cost) for every successor of
+// state, so only the states the search reaches are ever built. They are numbered by a StateTable, and the search tree is
+// kept as parent and distance arrays indexed by those numbers, like ShortestPathSearch does for vertices.
+template <typename S, typename Successors, typename Hash = std::hash<S>, typename Equal = std::equal_to<S>>
+struct ImplicitSearch {
+    Successors successors;
+    StateTable<S, Hash, Equal> table;
+    std::vector<int> parent;     // -1 for the start
+    std::vector<float> distance; // Cost of the best path found from the start
+    IndexedHeap open;
+    RingBuffer<int> queue;
+    int max_states = std::numeric_limits<int>::max(); // The search gives up once it has generated more states
+    int n_expanded = 0;
+
+    ImplicitSearch(Successors new_successors, Hash hash = Hash(), Equal equal = Equal())
+        : successors(new_successors), table(hash, equal) {}
+
+    // Breadth first search from start until a state satisfies is_goal(state). Returns its id, -1 when there is none or
+    // max_states was exceeded.
+    template <typename Goal>
+    int breadth_first(const S& start, Goal is_goal) {
+        initialize_search(start);
+        queue.clear();
+        queue.push_back(0);
+        while (!queue.empty()) {
+            int id = queue.pop_front();
+            if (is_goal(table[id])) {
+                return id;
+            }
+            n_expanded++;
+            bool full = false;
+            successors(table[id], [&](const S& next, float cost) {
+                auto added = table.insert(next);
+                if (added.second) {
+                    add_state(id, distance[id] + cost);
+                    queue.push_back(added.first);
+                    full = full || table.size() > max_states;
+                }
+            });
+            if (full) {
+                return -1;
+            }
+        }
+        return -1;
+    }
+
+    // A* from start until a state satisfies is_goal(state), h(state) being a lower bound of the cost to a goal. Returns
+    // the id of the goal reached, -1 when there is none or max_states was exceeded.
+    template <typename Goal, typename Heuristic>
+    int a_star(const S& start, Goal is_goal, Heuristic h) {
+        initialize_search(start);
+        open.reset(0);
+        open.add_vertex();
+        open.push(0, h(start));
+        while (!open.empty()) {
+            int id = open.pop();
+            if (is_goal(table[id])) {
+                return id;
+            }
+            n_expanded++;
+            bool full = false;
+            successors(table[id], [&](const S& next, float cost) {
+                auto added = table.insert(next);
+                int next_id = added.first;
+                float next_distance = distance[id] + cost;
+                if (added.second) {
+                    add_state(id, next_distance);
+                    open.add_vertex();
+                    open.push(next_id, next_distance + h(next));
+                    full = full || table.size() > max_states;
+                } else if (next_distance < distance[next_id]) {
+                    distance[next_id] = next_distance;
+                    parent[next_id] = id;
+                    if (open.contains(next_id)) {
+                        open.decrease_key(next_id, next_distance + h(next));
+                    } else {
+                        open.push(next_id, next_distance + h(next));
+                    }
+                }
+            });
+            if (full) {
+                return -1;
+            }
+        }
+        return -1;
+    }
+
+    template <typename Goal>
+    int dijkstra(const S& start, Goal is_goal) {
+        return a_star(start, is_goal, [](const S&) { return 0.f; });
+    }
+
+    // States from the start to state id
+    std::vector<S> path(int id) const {
+        std::vector<S> result;
+        for (; id != -1; id = parent[id]) {
+            result.push_back(table[id]);
+        }
+        return flip(result);
+    }
+
+    private:
+        void initialize_search(const S& start) {
+            table.clear();
+            parent.clear();
+            distance.clear();
+            n_expanded = 0;
+            table.insert(start);
+            add_state(-1, 0);
+        }
+
+        void add_state(int from, float cost) {
+            parent.push_back(from);
+            distance.push_back(cost);
+        }
+};
+
+// Lets the state type be given alone, the functor types being deduced
+template <typename S, typename Successors, typename Hash = std::hash<S>, typename Equal = std::equal_to<S>>
+ImplicitSearch<S, Successors, Hash, Equal> make_implicit_search(Successors successors, Hash hash = Hash(), Equal equal = Equal()) {
+    return ImplicitSearch<S, Successors, Hash, Equal>(successors, hash, equal);
+}
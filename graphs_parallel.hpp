@@ -0,0 +1,217 @@
+#pragma once
+#include "graphs.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Breadth first search tree: parent[v] is the vertex v was reached from (-1 for the source and vertices not reached),
+// distance[v] its number of edges from the source (-1 when not reached)
+struct BFSTree {
+    std::vector<int> parent;
+    std::vector<int> distance;
+};
+
+// Lets the threads of parallel_bfs() wait for each other between the phases of a level
+struct BFSBarrier {
+    std::mutex mutex;
+    std::condition_variable changed;
+    int n_threads = 0;
+    int n_waiting = 0;
+    long long phase = 0;
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        long long current = phase;
+        if (++n_waiting == n_threads) {
+            n_waiting = 0;
+            phase++;
+            changed.notify_all();
+            return;
+        }
+        changed.wait(lock, [&] { return phase != current; });
+    }
+};
+
+// Level synchronous breadth first search from source on n_threads threads (0 uses every hardware thread), switching
+// direction by level. Top down, the threads expand the vertices of the frontier and claim their unvisited successors.
+// Bottom up, each unvisited vertex looks for a predecessor in the frontier, kept as a bitmap, and stops at the first one
+// it finds: once the frontier holds a large part of the graph this checks far fewer edges. incoming holds the edges of
+// graph turned around, see reversed(), and is graph itself for undirected graphs.
+// note: Direction switches follow Beamer et al., bottom up when the frontier grows and the edges out of it exceed 1/14
+// of the edges out of unvisited vertices, top down again when it holds fewer than 1/24 of the vertices.
+inline BFSTree parallel_bfs(const Graph& graph, const Graph& incoming, int source, int n_threads = 0) {
+    int n_vertices = graph.n_vertices();
+    BFSTree tree;
+    if (source < 0 || source >= n_vertices || incoming.n_vertices() != n_vertices) {
+        std::cerr << "Error : Source " << source << " or incoming edges do not match the graph" << std::endl;
+        return tree;
+    }
+    if (n_threads <= 0) {
+        n_threads = std::thread::hardware_concurrency();
+        n_threads = n_threads > 0 ? n_threads : 1;
+    }
+    const int alpha = 14;
+    const int beta = 24;
+    const int chunk = 64; // Vertices per task, a multiple of 64 so that a bitmap word belongs to one thread bottom up
+
+    std::unique_ptr<std::atomic<int>[]> parent(new std::atomic<int>[n_vertices]);
+    for (int v = 0; v < n_vertices; v++) {
+        parent[v].store(-1, std::memory_order_relaxed);
+    }
+    tree.distance.assign(n_vertices, -1);
+    int n_words = (n_vertices + 63) / 64;
+    std::vector<uint64_t> frontier_bits(n_words, 0);
+    std::vector<uint64_t> next_bits(n_words, 0);
+    std::vector<int> frontier = {source};
+    std::vector<std::vector<int>> next_frontiers(n_threads); // Vertices claimed by each thread top down
+    std::vector<long long> next_edges(n_threads, 0);         // Edges out of the vertices each thread reached
+    std::vector<int> next_sizes(n_threads, 0);
+
+    // The source is its own parent while searching, so that nobody claims it
+    parent[source].store(source, std::memory_order_relaxed);
+    tree.distance[source] = 0;
+    int level = 0;
+    bool bottom_up = false;
+    bool done = false;
+    long long unexplored_edges = graph.n_edges() - graph.degree(source);
+    long long frontier_size = 1;
+    std::atomic<int> next_task{0};
+    BFSBarrier barrier;
+    barrier.n_threads = n_threads;
+
+    auto top_down_step = [&](int t) {
+        auto& found = next_frontiers[t];
+        found.clear();
+        long long edges = 0;
+        for (int task = next_task++; task*chunk < frontier.size(); task = next_task++) {
+            int end = (task + 1)*chunk < frontier.size() ? (task + 1)*chunk : frontier.size();
+            for (int i = task*chunk; i < end; i++) {
+                int u = frontier[i];
+                for (int e = graph.offsets[u]; e < graph.offsets[u+1]; e++) {
+                    int v = graph.targets[e];
+                    int unclaimed = -1;
+                    if (parent[v].load(std::memory_order_relaxed) == -1 &&
+                        parent[v].compare_exchange_strong(unclaimed, u, std::memory_order_relaxed)) {
+                        tree.distance[v] = level + 1;
+                        found.push_back(v);
+                        edges += graph.degree(v);
+                    }
+                }
+            }
+        }
+        next_edges[t] = edges;
+        next_sizes[t] = found.size();
+    };
+
+    auto bottom_up_step = [&](int t) {
+        long long edges = 0;
+        int size = 0;
+        for (int task = next_task++; task*chunk < n_vertices; task = next_task++) {
+            int end = (task + 1)*chunk < n_vertices ? (task + 1)*chunk : n_vertices;
+            uint64_t word = 0;
+            for (int v = task*chunk; v < end; v++) {
+                if (parent[v].load(std::memory_order_relaxed) != -1) {
+                    continue;
+                }
+                for (int e = incoming.offsets[v]; e < incoming.offsets[v+1]; e++) {
+                    int u = incoming.targets[e];
+                    if ((frontier_bits[u / 64] >> (u % 64)) & 1) {
+                        parent[v].store(u, std::memory_order_relaxed);
+                        tree.distance[v] = level + 1;
+                        word |= uint64_t(1) << (v % 64);
+                        edges += graph.degree(v);
+                        size++;
+                        break;
+                    }
+                }
+            }
+            next_bits[task] = word;
+        }
+        next_edges[t] = edges;
+        next_sizes[t] = size;
+    };
+
+    // Run by one thread between levels: gathers the next frontier in the form the next direction needs
+    auto next_level = [&]() {
+        long long edges = 0;
+        long long size = 0;
+        for (int t = 0; t < n_threads; t++) {
+            edges += next_edges[t];
+            size += next_sizes[t];
+        }
+        unexplored_edges -= edges;
+        bool next_bottom_up = bottom_up ? size >= n_vertices / beta : size > frontier_size && edges > unexplored_edges / alpha;
+
+        if (!bottom_up && !next_bottom_up) {
+            frontier.clear();
+            for (const auto& found : next_frontiers) {
+                frontier.insert(frontier.end(), found.begin(), found.end());
+            }
+        } else if (!bottom_up && next_bottom_up) {
+            std::fill(frontier_bits.begin(), frontier_bits.end(), 0);
+            for (const auto& found : next_frontiers) {
+                for (int v : found) {
+                    frontier_bits[v / 64] |= uint64_t(1) << (v % 64);
+                }
+            }
+        } else if (bottom_up && next_bottom_up) {
+            frontier_bits.swap(next_bits);
+        } else {
+            frontier.clear();
+            for (int w = 0; w < n_words; w++) {
+                int bit = 0;
+                for (uint64_t word = next_bits[w]; word != 0; word >>= 1, bit++) {
+                    if (word & 1) {
+                        frontier.push_back(64*w + bit);
+                    }
+                }
+            }
+        }
+        bottom_up = next_bottom_up;
+        frontier_size = size;
+        level++;
+        next_task = 0;
+        done = size == 0;
+    };
+
+    auto worker = [&](int t) {
+        while (true) {
+            if (bottom_up) {
+                bottom_up_step(t);
+            } else {
+                top_down_step(t);
+            }
+            barrier.wait();
+            if (t == 0) {
+                next_level();
+            }
+            barrier.wait();
+            if (done) {
+                return;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 1; t < n_threads; t++) {
+        workers.emplace_back(worker, t);
+    }
+    worker(0);
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    tree.parent.resize(n_vertices);
+    for (int v = 0; v < n_vertices; v++) {
+        tree.parent[v] = parent[v].load(std::memory_order_relaxed);
+    }
+    tree.parent[source] = -1;
+    return tree;
+}
+
+// For undirected graphs, the incoming edges are the graph itself
+inline BFSTree parallel_bfs(const Graph& graph, int source, int n_threads = 0) {
+    return parallel_bfs(graph, graph, source, n_threads);
+}
@@ -0,0 +1,453 @@
+#pragma once
+#include "task.hpp"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#if defined(_WIN32)
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// Binary file format of a finalized (set up) TaskSequencingProblem.
+// The file is a header followed by 64 bytes aligned sections, so that once mapped every section can be read in place.
+// note: Values are stored in native endianness and real type, which the header records and open() checks.
+
+constexpr uint64_t PROBLEM_FILE_MAGIC = 0x31424f5250515354ull; // "TSQPROB1"
+constexpr uint32_t PROBLEM_FILE_VERSION = 1;
+constexpr uint64_t PROBLEM_FILE_ALIGNMENT = 64;
+
+enum class ProblemFileSection {
+    task_ids,               // int32[n_tasks]
+    start_positions,        // real[n_tasks][n_joints]
+    start_velocities,       // real[n_tasks][n_joints]
+    start_accelerations,    // real[n_tasks][n_joints]
+    end_positions,          // real[n_tasks][n_joints]
+    end_velocities,         // real[n_tasks][n_joints]
+    end_accelerations,      // real[n_tasks][n_joints]
+    start_position,         // real[n_joints]
+    cost,                   // real[n_tasks][n_tasks], row major
+    cost_from_start,        // real[n_tasks]
+    minimum_cost_to_reach,  // real[n_tasks]
+    task_domain,            // real[n_tasks][n_tasks], row major
+    order_constraints,      // int32[n_order_constraints][2]
+    following_constraints,  // int32[n_following_constraints][2]
+    phantom_following_constraints, // int32[n_phantom_following_constraints][2]
+    domain_constraints,     // int32[n_domain_constraints][2] : task id, number of values
+    domain_values           // real[sum of domain constraint sizes]
+};
+constexpr int PROBLEM_FILE_N_SECTIONS = (int)ProblemFileSection::domain_values + 1;
+
+struct ProblemFileHeader {
+    uint64_t magic = PROBLEM_FILE_MAGIC;
+    uint32_t version = PROBLEM_FILE_VERSION;
+    uint32_t real_size = sizeof(real);
+
+    int32_t n_tasks = 0;
+    int32_t n_joints = 0;
+    int32_t n_joint_space_tasks = 0;
+    int32_t n_cartesian_space_tasks = 0;
+    int32_t n_order_constraints = 0;
+    int32_t n_following_constraints = 0;
+    int32_t n_phantom_following_constraints = 0;
+    int32_t n_domain_constraints = 0;
+    int32_t n_domain_values = 0;
+    int32_t padding = 0;
+
+    uint64_t offsets[PROBLEM_FILE_N_SECTIONS] = {};
+    uint64_t sizes[PROBLEM_FILE_N_SECTIONS] = {}; // In bytes
+    uint64_t file_size = 0;
+};
+
+// Sets the size in bytes of every section from the counts of header
+inline void problem_file_section_sizes(ProblemFileHeader& header) {
+    uint64_t task_matrix_size = (uint64_t)header.n_tasks*header.n_joints*sizeof(real);
+    header.sizes[(int)ProblemFileSection::task_ids] = (uint64_t)header.n_tasks*sizeof(int32_t);
+    header.sizes[(int)ProblemFileSection::start_positions] = task_matrix_size;
+    header.sizes[(int)ProblemFileSection::start_velocities] = task_matrix_size;
+    header.sizes[(int)ProblemFileSection::start_accelerations] = task_matrix_size;
+    header.sizes[(int)ProblemFileSection::end_positions] = task_matrix_size;
+    header.sizes[(int)ProblemFileSection::end_velocities] = task_matrix_size;
+    header.sizes[(int)ProblemFileSection::end_accelerations] = task_matrix_size;
+    header.sizes[(int)ProblemFileSection::start_position] = (uint64_t)header.n_joints*sizeof(real);
+    header.sizes[(int)ProblemFileSection::cost] = (uint64_t)header.n_tasks*header.n_tasks*sizeof(real);
+    header.sizes[(int)ProblemFileSection::cost_from_start] = (uint64_t)header.n_tasks*sizeof(real);
+    header.sizes[(int)ProblemFileSection::minimum_cost_to_reach] = (uint64_t)header.n_tasks*sizeof(real);
+    header.sizes[(int)ProblemFileSection::task_domain] = (uint64_t)header.n_tasks*header.n_tasks*sizeof(real);
+    header.sizes[(int)ProblemFileSection::order_constraints] = (uint64_t)header.n_order_constraints*2*sizeof(int32_t);
+    header.sizes[(int)ProblemFileSection::following_constraints] = (uint64_t)header.n_following_constraints*2*sizeof(int32_t);
+    header.sizes[(int)ProblemFileSection::phantom_following_constraints] = (uint64_t)header.n_phantom_following_constraints*2*sizeof(int32_t);
+    header.sizes[(int)ProblemFileSection::domain_constraints] = (uint64_t)header.n_domain_constraints*2*sizeof(int32_t);
+    header.sizes[(int)ProblemFileSection::domain_values] = (uint64_t)header.n_domain_values*sizeof(real);
+}
+
+// Read only memory mapping of a whole file
+struct MappedFile {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+#if defined(_WIN32)
+        file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_handle == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0) {
+            close();
+            return false;
+        }
+        mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping_handle) {
+            close();
+            return false;
+        }
+        data = static_cast<const unsigned char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+        size = (size_t)file_size.QuadPart;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // The mapping keeps its own reference to the file
+        if (mapping == MAP_FAILED) {
+            return false;
+        }
+        data = static_cast<const unsigned char*>(mapping);
+        size = (size_t)file_stat.st_size;
+#endif
+        if (!data) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+#if defined(_WIN32)
+        if (data) {
+            UnmapViewOfFile(data);
+        }
+        if (mapping_handle) {
+            CloseHandle(mapping_handle);
+            mapping_handle = nullptr;
+        }
+        if (file_handle != INVALID_HANDLE_VALUE) {
+            CloseHandle(file_handle);
+            file_handle = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (data) {
+            munmap(const_cast<unsigned char*>(data), size);
+        }
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    private:
+#if defined(_WIN32)
+        HANDLE file_handle = INVALID_HANDLE_VALUE;
+        HANDLE mapping_handle = nullptr;
+#endif
+};
+
+// Zero copy view of a problem file. Every accessor reads straight from the mapping, which can be shared by many processes.
+struct MappedTaskSequencingProblem {
+    MappedFile file;
+    const ProblemFileHeader* header = nullptr;
+
+    bool open(const std::string& path) {
+        header = nullptr;
+        if (!file.open(path)) {
+            std::cerr << "Error : Could not map " << path << std::endl;
+            return false;
+        }
+        auto candidate = reinterpret_cast<const ProblemFileHeader*>(file.data);
+        if (file.size < sizeof(ProblemFileHeader) ||
+            candidate->magic != PROBLEM_FILE_MAGIC ||
+            candidate->version != PROBLEM_FILE_VERSION ||
+            candidate->real_size != sizeof(real) ||
+            candidate->file_size != file.size) {
+                std::cerr << "Error : " << path << " is not a compatible problem file" << std::endl;
+                file.close();
+                return false;
+            }
+        if (!valid_sections(*candidate)) {
+            std::cerr << "Error : " << path << " is corrupted" << std::endl;
+            file.close();
+            return false;
+        }
+        header = candidate;
+        return true;
+    }
+
+    int n_tasks() const { return header->n_tasks; }
+    int n_joints() const { return header->n_joints; }
+
+    template <typename T>
+    const T* section(ProblemFileSection id) const {
+        return reinterpret_cast<const T*>(file.data + header->offsets[(int)id]);
+    }
+
+    int task_id(int task) const { return section<int32_t>(ProblemFileSection::task_ids)[task]; }
+    // Joint positions of one working set task (n_joints contiguous values)
+    const real* task_start_position(int task) const { return section<real>(ProblemFileSection::start_positions) + (size_t)task*n_joints(); }
+    const real* task_end_position(int task) const { return section<real>(ProblemFileSection::end_positions) + (size_t)task*n_joints(); }
+
+    real cost(int row, int col) const { return section<real>(ProblemFileSection::cost)[(size_t)row*n_tasks() + col]; }
+    real cost_from_start(int task) const { return section<real>(ProblemFileSection::cost_from_start)[task]; }
+    real minimum_cost_to_reach(int task) const { return section<real>(ProblemFileSection::minimum_cost_to_reach)[task]; }
+    real task_domain(int row, int col) const { return section<real>(ProblemFileSection::task_domain)[(size_t)row*n_tasks() + col]; }
+
+    private:
+        // Every section must have exactly the size save_task_sequencing_problem() gives it for the counts of the header, and
+        // fit in the file, so that the accessors cannot read past it. The domain sizes must add up to n_domain_values.
+        bool valid_sections(const ProblemFileHeader& candidate) const {
+            const int32_t counts[] = {candidate.n_tasks, candidate.n_joints, candidate.n_joint_space_tasks,
+                candidate.n_cartesian_space_tasks, candidate.n_order_constraints, candidate.n_following_constraints,
+                candidate.n_phantom_following_constraints, candidate.n_domain_constraints, candidate.n_domain_values};
+            for (int32_t count : counts) {
+                if (count < 0 || (uint64_t)count > file.size) {
+                    return false;
+                }
+            }
+            // Bounds the products below, so that the expected sizes cannot overflow
+            if ((uint64_t)candidate.n_tasks*candidate.n_tasks > file.size || (uint64_t)candidate.n_tasks*candidate.n_joints > file.size) {
+                return false;
+            }
+
+            ProblemFileHeader expected = candidate;
+            problem_file_section_sizes(expected);
+            for (int i = 0; i < PROBLEM_FILE_N_SECTIONS; i++) {
+                if (candidate.sizes[i] != expected.sizes[i] ||
+                    candidate.offsets[i] % PROBLEM_FILE_ALIGNMENT != 0 ||
+                    candidate.offsets[i] < sizeof(ProblemFileHeader) ||
+                    candidate.offsets[i] > file.size ||
+                    candidate.sizes[i] > file.size - candidate.offsets[i]) {
+                    return false;
+                }
+            }
+
+            auto domain_constraints = reinterpret_cast<const int32_t*>(file.data + candidate.offsets[(int)ProblemFileSection::domain_constraints]);
+            int64_t n_domain_values = 0;
+            for (int i = 0; i < candidate.n_domain_constraints; i++) {
+                int32_t size = domain_constraints[2*i + 1];
+                if (size < 0) {
+                    return false;
+                }
+                n_domain_values += size;
+            }
+            return n_domain_values == candidate.n_domain_values;
+        }
+};
+
+// Writes a problem on which setup() has been called.
+inline bool save_task_sequencing_problem(const TaskSequencingProblem& problem, const std::string& path) {
+    int n_tasks = problem.working_set.size();
+    int n_joints = problem.manip.joints;
+
+    if (problem.cost.rows != n_tasks || problem.task_domain.rows != n_tasks) {
+        std::cerr << "Error : setup() must be called before saving a problem" << std::endl;
+        return false;
+    }
+
+    ProblemFileHeader header;
+    header.n_tasks = n_tasks;
+    header.n_joints = n_joints;
+    header.n_joint_space_tasks = problem.joint_space_tasks.size();
+    header.n_cartesian_space_tasks = problem.cartesian_space_tasks.size();
+    header.n_order_constraints = problem.order_constraints.size();
+    header.n_following_constraints = problem.following_constraints.size();
+    header.n_phantom_following_constraints = problem.phantom_following_constraints.size();
+    header.n_domain_constraints = problem.domain_constraints.size();
+    for (const auto& constraint : problem.domain_constraints) {
+        header.n_domain_values += constraint.domain.size;
+    }
+
+    problem_file_section_sizes(header);
+
+    uint64_t offset = sizeof(ProblemFileHeader);
+    for (int i = 0; i < PROBLEM_FILE_N_SECTIONS; i++) {
+        offset = (offset + PROBLEM_FILE_ALIGNMENT - 1) / PROBLEM_FILE_ALIGNMENT * PROBLEM_FILE_ALIGNMENT;
+        header.offsets[i] = offset;
+        offset += header.sizes[i];
+    }
+    header.file_size = offset;
+
+    // Assemble the whole file in memory, sections are then written in place
+    std::vector<unsigned char> buffer(header.file_size, 0);
+    std::memcpy(buffer.data(), &header, sizeof(header));
+
+    auto section = [&](ProblemFileSection id) { return buffer.data() + header.offsets[(int)id]; };
+    auto put_int = [&](ProblemFileSection id, size_t i, int32_t value) { std::memcpy(section(id) + i*sizeof(int32_t), &value, sizeof(int32_t)); };
+    auto put_real = [&](ProblemFileSection id, size_t i, real value) { std::memcpy(section(id) + i*sizeof(real), &value, sizeof(real)); };
+
+    for (int i = 0; i < n_tasks; i++) {
+        const auto& task = problem.working_set[i];
+        put_int(ProblemFileSection::task_ids, i, task.task_id);
+        for (int j = 0; j < n_joints; j++) {
+            size_t k = (size_t)i*n_joints + j;
+            put_real(ProblemFileSection::start_positions, k, task.start_position[j]);
+            put_real(ProblemFileSection::start_velocities, k, task.start_velocity[j]);
+            put_real(ProblemFileSection::start_accelerations, k, task.start_acceleration[j]);
+            put_real(ProblemFileSection::end_positions, k, task.end_position[j]);
+            put_real(ProblemFileSection::end_velocities, k, task.end_velocity[j]);
+            put_real(ProblemFileSection::end_accelerations, k, task.end_acceleration[j]);
+        }
+        put_real(ProblemFileSection::cost_from_start, i, problem.cost_from_start[i]);
+        put_real(ProblemFileSection::minimum_cost_to_reach, i, problem.minimum_cost_to_reach[i]);
+        for (int j = 0; j < n_tasks; j++) {
+            put_real(ProblemFileSection::cost, (size_t)i*n_tasks + j, problem.cost(i, j));
+            put_real(ProblemFileSection::task_domain, (size_t)i*n_tasks + j, problem.task_domain(i, j));
+        }
+    }
+    for (int j = 0; j < n_joints; j++) {
+        put_real(ProblemFileSection::start_position, j, problem.start_position[j]);
+    }
+    for (int i = 0; i < header.n_order_constraints; i++) {
+        put_int(ProblemFileSection::order_constraints, 2*i, problem.order_constraints[i].earlier);
+        put_int(ProblemFileSection::order_constraints, 2*i + 1, problem.order_constraints[i].later);
+    }
+    for (int i = 0; i < header.n_following_constraints; i++) {
+        put_int(ProblemFileSection::following_constraints, 2*i, problem.following_constraints[i].earlier);
+        put_int(ProblemFileSection::following_constraints, 2*i + 1, problem.following_constraints[i].later);
+    }
+    for (int i = 0; i < header.n_phantom_following_constraints; i++) {
+        put_int(ProblemFileSection::phantom_following_constraints, 2*i, problem.phantom_following_constraints[i].earlier);
+        put_int(ProblemFileSection::phantom_following_constraints, 2*i + 1, problem.phantom_following_constraints[i].later);
+    }
+    size_t value_idx = 0;
+    for (int i = 0; i < header.n_domain_constraints; i++) {
+        const auto& constraint = problem.domain_constraints[i];
+        put_int(ProblemFileSection::domain_constraints, 2*i, constraint.task_id);
+        put_int(ProblemFileSection::domain_constraints, 2*i + 1, constraint.domain.size);
+        for (int j = 0; j < constraint.domain.size; j++) {
+            put_real(ProblemFileSection::domain_values, value_idx++, constraint.domain[j]);
+        }
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error : Could not open " << path << " for writing" << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    return (bool)file;
+}
+
+// Fills a problem from a mapped file, skipping setup(). The problem is ready for A_star().
+// note: A_star() works on blast containers, so the tables are copied once (no parsing). Read the view directly to avoid it.
+// note: Tasks are not stored, only the resulting working set. Do not add tasks or constraints to the loaded problem.
+inline bool load_task_sequencing_problem(const MappedTaskSequencingProblem& view, TaskSequencingProblem& problem) {
+    if (!view.header) {
+        std::cerr << "Error : Problem file is not opened" << std::endl;
+        return false;
+    }
+    int n_tasks = view.n_tasks();
+    int n_joints = view.n_joints();
+    if (n_joints != problem.manip.joints) {
+        std::cerr << "Error : Problem file has " << n_joints << " joints, manipulator has " << problem.manip.joints << std::endl;
+        return false;
+    }
+
+    auto copy_array = [&](ProblemFileSection id, int row, Array& values) {
+        const real* source = view.section<real>(id) + (size_t)row*n_joints;
+        values = Array(n_joints);
+        for (int j = 0; j < n_joints; j++) {
+            values[j] = source[j];
+        }
+    };
+
+    problem.working_set.clear();
+    problem.working_set.reserve(n_tasks);
+    for (int i = 0; i < n_tasks; i++) {
+        JointTask task;
+        task.task_id = view.task_id(i);
+        copy_array(ProblemFileSection::start_positions, i, task.start_position);
+        copy_array(ProblemFileSection::start_velocities, i, task.start_velocity);
+        copy_array(ProblemFileSection::start_accelerations, i, task.start_acceleration);
+        copy_array(ProblemFileSection::end_positions, i, task.end_position);
+        copy_array(ProblemFileSection::end_velocities, i, task.end_velocity);
+        copy_array(ProblemFileSection::end_accelerations, i, task.end_acceleration);
+        problem.working_set.push_back(std::move(task));
+    }
+    copy_array(ProblemFileSection::start_position, 0, problem.start_position);
+
+    problem.cost.resize(n_tasks, n_tasks);
+    problem.task_domain.resize(n_tasks, n_tasks);
+    problem.cost_from_start.resize(n_tasks);
+    problem.minimum_cost_to_reach.resize(n_tasks);
+    for (int i = 0; i < n_tasks; i++) {
+        problem.cost_from_start[i] = view.cost_from_start(i);
+        problem.minimum_cost_to_reach[i] = view.minimum_cost_to_reach(i);
+        for (int j = 0; j < n_tasks; j++) {
+            problem.cost(i, j) = view.cost(i, j);
+            problem.task_domain(i, j) = view.task_domain(i, j);
+        }
+    }
+
+    auto pairs = [&](ProblemFileSection id, int i, int k) { return view.section<int32_t>(id)[2*i + k]; };
+    problem.order_constraints.resize(view.header->n_order_constraints);
+    for (int i = 0; i < view.header->n_order_constraints; i++) {
+        problem.order_constraints[i].earlier = pairs(ProblemFileSection::order_constraints, i, 0);
+        problem.order_constraints[i].later = pairs(ProblemFileSection::order_constraints, i, 1);
+    }
+    problem.following_constraints.resize(view.header->n_following_constraints);
+    for (int i = 0; i < view.header->n_following_constraints; i++) {
+        problem.following_constraints[i].earlier = pairs(ProblemFileSection::following_constraints, i, 0);
+        problem.following_constraints[i].later = pairs(ProblemFileSection::following_constraints, i, 1);
+    }
+    problem.phantom_following_constraints.resize(view.header->n_phantom_following_constraints);
+    for (int i = 0; i < view.header->n_phantom_following_constraints; i++) {
+        problem.phantom_following_constraints[i].earlier = pairs(ProblemFileSection::phantom_following_constraints, i, 0);
+        problem.phantom_following_constraints[i].later = pairs(ProblemFileSection::phantom_following_constraints, i, 1);
+    }
+    problem.domain_constraints.resize(view.header->n_domain_constraints);
+    const real* domain_values = view.section<real>(ProblemFileSection::domain_values);
+    for (int i = 0; i < view.header->n_domain_constraints; i++) {
+        problem.domain_constraints[i].task_id = pairs(ProblemFileSection::domain_constraints, i, 0);
+        problem.domain_constraints[i].domain = Array(pairs(ProblemFileSection::domain_constraints, i, 1));
+        for (int j = 0; j < problem.domain_constraints[i].domain.size; j++) {
+            problem.domain_constraints[i].domain[j] = *domain_values++;
+        }
+    }
+
+    // A_star() counts clusters from the task lists
+    problem.tasks.clear();
+    problem.joint_space_tasks.assign(view.header->n_joint_space_tasks, JointTask());
+    problem.cartesian_space_tasks.assign(view.header->n_cartesian_space_tasks, CartesianTask());
+
+    return true;
+}
+
+inline bool load_task_sequencing_problem(const std::string& path, TaskSequencingProblem& problem) {
+    MappedTaskSequencingProblem view;
+    if (!view.open(path)) {
+        return false;
+    }
+    return load_task_sequencing_problem(view, problem);
+}
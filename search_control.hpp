@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <limits>
+
+enum class SearchStatus {
+    running,
+    finished,      // The search ran to its end, whether or not it found a solution
+    cancelled,     // cancel() was called or the progress callback returned false
+    timed_out,     // The deadline passed
+    out_of_nodes   // node_budget nodes were expanded
+};
+
+struct SearchProgress {
+    long long n_nodes;
+    double elapsed;    // Seconds since the search started
+    double best_bound; // Largest bound polled so far: lowest total cost of an open node for A_star(), deepest level for CSP
+};
+
+// Limits of a search, shared by A_star() and the CSP searches. The search calls poll() once per node expanded, which
+// only counts the node and compares it to node_budget. At the first node and every check_interval nodes after it, it
+// also reads the clock and the cancel flag, and calls on_progress once progress_interval seconds went by. Once poll()
+// returns false the search gives up and status tells why.
+// note: cancel() may be called from any thread, before or during the search, and a cancelled control stops every later
+// search until reset_cancel(). The other settings must not change during the search.
+struct SearchControl {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    long long node_budget = -1; // -1 for no limit
+    int check_interval = 1024;  // Nodes between two reads of the clock, rounded up to a power of two (at least 1) by start()
+    double progress_interval = 0.5;
+    std::function<bool(const SearchProgress&)> on_progress; // Returns false to cancel the search
+
+    SearchStatus status = SearchStatus::finished;
+    long long n_nodes = 0;
+    double best_bound = -std::numeric_limits<double>::infinity();
+
+    void set_time_budget(double seconds) {
+        deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    }
+
+    void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+    void reset_cancel() { cancelled.store(false, std::memory_order_relaxed); }
+
+    // Called by the search as it starts
+    void start() {
+        status = SearchStatus::running;
+        n_nodes = 0;
+        best_bound = -std::numeric_limits<double>::infinity();
+        start_time = std::chrono::steady_clock::now();
+        next_progress = progress_interval;
+        check_mask = 0;
+        while (check_mask + 1 < check_interval) {
+            check_mask = 2*check_mask + 1;
+        }
+    }
+
+    // Called by the search as it ends without being stopped
+    void finish() {
+        if (status == SearchStatus::running) {
+            status = SearchStatus::finished;
+        }
+    }
+
+    bool poll(double bound) {
+        n_nodes++;
+        best_bound = bound > best_bound ? bound : best_bound;
+        if (node_budget >= 0 && n_nodes > node_budget) {
+            status = SearchStatus::out_of_nodes;
+            return false;
+        }
+        if (((n_nodes - 1) & check_mask) != 0) {
+            return true;
+        }
+        return check();
+    }
+
+    SearchProgress progress() const {
+        return {n_nodes, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count(), best_bound};
+    }
+
+    private:
+        std::atomic<bool> cancelled{false};
+        std::chrono::steady_clock::time_point start_time;
+        double next_progress = 0; // Elapsed seconds of the next progress callback
+        long long check_mask = 0; // check_interval as a power of two, minus one
+
+        bool check() {
+            if (cancelled.load(std::memory_order_relaxed)) {
+                status = SearchStatus::cancelled;
+                return false;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (now >= deadline) {
+                status = SearchStatus::timed_out;
+                return false;
+            }
+            if (on_progress) {
+                double elapsed = std::chrono::duration<double>(now - start_time).count();
+                if (elapsed >= next_progress) {
+                    next_progress = elapsed + progress_interval;
+                    if (!on_progress({n_nodes, elapsed, best_bound})) {
+                        status = SearchStatus::cancelled;
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+};
@@ -0,0 +1,315 @@
+#pragma once
+#include "A_star.hpp"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+// FNV-1a 64 bits, fed with quantized problem content
+struct ProblemFingerprint {
+    uint64_t hash = FNV1A_OFFSET;
+    real tolerance = 1e-6;
+
+    void add_bytes(const void* data, size_t n_bytes) {
+        hash = fnv1a(hash, data, n_bytes);
+    }
+
+    void add(int64_t value) {
+        add_bytes(&value, sizeof(value));
+    }
+
+    // Values closer than tolerance usually map to the same bucket, which makes near-identical problems hit the cache.
+    // note: Two values straddling a bucket boundary still hash differently, it only costs a cache miss.
+    void add(real value) {
+        add((int64_t)std::llround(value / tolerance));
+    }
+
+    void add(const Array& values) {
+        add((int64_t)values.size);
+        for (int i = 0; i < values.size; i++) {
+            add(values[i]);
+        }
+    }
+};
+
+// Content hash of everything setup() and A_star() depend on: tasks, constraints, start position, manipulator limits and
+// cost model.
+// note: The working set is derived deterministically from tasks in setup(), so hashing the tasks lets a hit skip setup() entirely.
+// note: Cartesian tasks are hashed by pose, their IK solutions are recomputed (and appended) by every setup().
+inline uint64_t problem_fingerprint(const TaskSequencingProblem& problem, real tolerance = 1e-6) {
+    ProblemFingerprint fingerprint;
+    fingerprint.tolerance = tolerance;
+
+    fingerprint.add((int64_t)problem.manip.joints);
+    fingerprint.add(problem.manip.vmax);
+    fingerprint.add(problem.manip.vmin);
+    fingerprint.add(problem.manip.amax);
+    fingerprint.add(problem.manip.amin);
+    fingerprint.add(problem.start_position);
+
+    // A null model is the trapezoidal time of setup()
+    fingerprint.add((int64_t)(problem.cost_model ? problem.cost_model->fingerprint() : 0));
+    fingerprint.add((int64_t)problem.cache_profiles);
+
+    fingerprint.add((int64_t)problem.tasks.size());
+    for (const auto& task : problem.tasks) {
+        fingerprint.add((int64_t)task.type);
+        if (task.type == TaskType::joint) {
+            fingerprint.add(task.joint_task.start_position);
+            fingerprint.add(task.joint_task.start_velocity);
+            fingerprint.add(task.joint_task.start_acceleration);
+            fingerprint.add(task.joint_task.end_position);
+            fingerprint.add(task.joint_task.end_velocity);
+            fingerprint.add(task.joint_task.end_acceleration);
+        } else {
+            fingerprint.add(task.cartesian_task.start_pose);
+            fingerprint.add(task.cartesian_task.end_pose);
+        }
+    }
+
+    fingerprint.add((int64_t)problem.order_constraints.size());
+    for (const auto& constraint : problem.order_constraints) {
+        fingerprint.add((int64_t)constraint.earlier);
+        fingerprint.add((int64_t)constraint.later);
+    }
+
+    fingerprint.add((int64_t)problem.following_constraints.size());
+    for (const auto& constraint : problem.following_constraints) {
+        fingerprint.add((int64_t)constraint.earlier);
+        fingerprint.add((int64_t)constraint.later);
+    }
+
+    fingerprint.add((int64_t)problem.domain_constraints.size());
+    for (const auto& constraint : problem.domain_constraints) {
+        fingerprint.add((int64_t)constraint.task_id);
+        fingerprint.add(constraint.domain);
+    }
+
+    return fingerprint.hash;
+}
+
+struct CachedSolution {
+    uint64_t key = 0;
+    bool success = false;
+    Array solution = {};
+    std::vector<std::vector<Array>> joint_space_solution = {};
+};
+
+// Least recently used cache of A_star() results, keyed on problem_fingerprint()
+struct SolutionCache {
+    size_t capacity = 64;
+    std::list<CachedSolution> entries; // Most recently used first
+    std::unordered_map<uint64_t, std::list<CachedSolution>::iterator> index;
+
+    int hits = 0;
+    int misses = 0;
+
+    SolutionCache(size_t new_capacity = 64)
+        : capacity(new_capacity) {}
+
+    // Returns nullptr on miss. A hit is moved to the front of the list.
+    const CachedSolution* find(uint64_t key) {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            misses++;
+            return nullptr;
+        }
+        hits++;
+        entries.splice(entries.begin(), entries, it->second);
+        return &entries.front();
+    }
+
+    void insert(CachedSolution entry) {
+        auto it = index.find(entry.key);
+        if (it != index.end()) {
+            entries.erase(it->second);
+            index.erase(it);
+        }
+        entries.push_front(std::move(entry));
+        index[entries.front().key] = entries.begin();
+
+        while (entries.size() > capacity) {
+            index.erase(entries.back().key);
+            entries.pop_back();
+        }
+    }
+
+    void clear() {
+        entries.clear();
+        index.clear();
+    }
+
+    // Binary layout: header, then entries from most to least recently used.
+    // note: Files are only portable between builds with the same real type and endianness, load() checks the former.
+    bool save(const std::string& path) const {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "Error : Could not open " << path << " for writing" << std::endl;
+            return false;
+        }
+
+        write_value(file, FILE_MAGIC);
+        write_value(file, FILE_VERSION);
+        write_value(file, (uint32_t)sizeof(real));
+        write_value(file, (uint64_t)entries.size());
+        for (const auto& entry : entries) {
+            write_value(file, entry.key);
+            write_value(file, (uint8_t)entry.success);
+            write_array(file, entry.solution);
+            write_value(file, (int32_t)entry.joint_space_solution.size());
+            for (const auto& positions : entry.joint_space_solution) {
+                write_value(file, (int32_t)positions.size());
+                for (const auto& position : positions) {
+                    write_array(file, position);
+                }
+            }
+        }
+        return (bool)file;
+    }
+
+    // Merges the file content into the cache, keeping the recency order it was saved with.
+    // note: Counts read from the file are checked against the bytes left before anything is allocated, so a truncated or
+    // corrupt file is rejected instead of throwing bad_alloc.
+    bool load(const std::string& path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) {
+            std::cerr << "Error : Could not open " << path << " for reading" << std::endl;
+            return false;
+        }
+        uint64_t file_size = file.tellg();
+        file.seekg(0);
+
+        uint64_t magic = 0;
+        uint32_t version = 0;
+        uint32_t real_size = 0;
+        uint64_t n_entries = 0;
+        read_value(file, magic);
+        read_value(file, version);
+        read_value(file, real_size);
+        read_value(file, n_entries);
+        if (!file || magic != FILE_MAGIC || version != FILE_VERSION || real_size != sizeof(real)) {
+            std::cerr << "Error : " << path << " is not a compatible solution cache file" << std::endl;
+            return false;
+        }
+
+        // Smallest entry: key, success, solution size and number of positions
+        const uint64_t min_entry_size = sizeof(uint64_t) + sizeof(uint8_t) + 2*sizeof(int32_t);
+        if (n_entries > remaining_bytes(file, file_size) / min_entry_size) {
+            file.setstate(std::ios::failbit);
+        }
+
+        std::vector<CachedSolution> loaded(file ? n_entries : 0);
+        for (auto& entry : loaded) {
+            uint8_t success = 0;
+            int32_t n_positions = 0;
+            read_value(file, entry.key);
+            read_value(file, success);
+            entry.success = success != 0;
+            read_array(file, entry.solution, file_size);
+            read_value(file, n_positions);
+            // Each list of positions takes at least its size
+            if (!file || n_positions < 0 || n_positions > remaining_bytes(file, file_size) / sizeof(int32_t)) {
+                file.setstate(std::ios::failbit);
+                break;
+            }
+            entry.joint_space_solution.resize(n_positions);
+            for (auto& positions : entry.joint_space_solution) {
+                int32_t n_arrays = 0;
+                read_value(file, n_arrays);
+                if (!file || n_arrays < 0 || n_arrays > remaining_bytes(file, file_size) / sizeof(int32_t)) {
+                    file.setstate(std::ios::failbit);
+                    break;
+                }
+                positions.resize(n_arrays);
+                for (auto& position : positions) {
+                    read_array(file, position, file_size);
+                }
+            }
+            if (!file) {
+                break;
+            }
+        }
+        if (!file) {
+            std::cerr << "Error : " << path << " is truncated" << std::endl;
+            return false;
+        }
+
+        for (auto it = loaded.rbegin(); it != loaded.rend(); it++) {
+            insert(std::move(*it));
+        }
+        return true;
+    }
+
+    private:
+        static constexpr uint64_t FILE_MAGIC = 0x45484341434e4c53ull; // "SLNCACHE"
+        static constexpr uint32_t FILE_VERSION = 1;
+
+        template <typename T>
+        static void write_value(std::ofstream& file, const T& value) {
+            file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        template <typename T>
+        static void read_value(std::ifstream& file, T& value) {
+            file.read(reinterpret_cast<char*>(&value), sizeof(T));
+        }
+
+        static void write_array(std::ofstream& file, const Array& values) {
+            write_value(file, (int32_t)values.size);
+            for (int i = 0; i < values.size; i++) {
+                write_value(file, values[i]);
+            }
+        }
+
+        // Bytes between the read position and the end of the file, 0 once a read failed
+        static uint64_t remaining_bytes(std::ifstream& file, uint64_t file_size) {
+            if (!file) {
+                return 0;
+            }
+            uint64_t position = file.tellg();
+            return position < file_size ? file_size - position : 0;
+        }
+
+        static void read_array(std::ifstream& file, Array& values, uint64_t file_size) {
+            int32_t size = 0;
+            read_value(file, size);
+            if (!file || size < 0 || size > remaining_bytes(file, file_size) / sizeof(real)) {
+                file.setstate(std::ios::failbit);
+                return;
+            }
+            values = Array(size);
+            for (int i = 0; i < size; i++) {
+                read_value(file, values[i]);
+            }
+        }
+};
+
+// A_star() behind a SolutionCache: on a hit neither setup() nor A_star() run.
+// note: On a miss, task is set up in place (like calling setup() yourself) and the result is stored, failures included.
+inline Array A_star_cached(SolutionCache& cache, TaskSequencingProblem& task, const World& world, bool* success, std::vector<std::vector<Array>>* joint_space_solution = nullptr, real tolerance = 1e-6) {
+    uint64_t key = problem_fingerprint(task, tolerance);
+
+    if (auto cached = cache.find(key)) {
+        *success = cached->success;
+        if (joint_space_solution) {
+            *joint_space_solution = cached->joint_space_solution;
+        }
+        return cached->solution;
+    }
+
+    task.setup(world);
+
+    CachedSolution entry;
+    entry.key = key;
+    entry.solution = A_star(task, &entry.success, &entry.joint_space_solution);
+
+    *success = entry.success;
+    if (joint_space_solution) {
+        *joint_space_solution = entry.joint_space_solution;
+    }
+    Array solution = entry.solution;
+    cache.insert(std::move(entry));
+    return solution;
+}
@@ -1,6 +1,9 @@
 #pragma once
 #include "blast_rush.h"
+#include "cost_model.hpp"
+#include "tracing.hpp"
 #include <iostream>
+#include <memory>
 #include <vector>
 
 using namespace blast;
@@ -121,45 +124,49 @@ struct Task {
         type(TaskType::cartesian), cartesian_task(new_task) {}
 };
 
+// Time for a single joint to travel task_displacement, starting and ending at rest
 // todo: Adapt for velocity different than 0
-inline real trapezoidal_velocity_profile_time(Matrix task, GenericManipulator manip) {
-    Array times(manip.joints);
+inline real trapezoidal_velocity_profile_time(real task_displacement, real vmax, real vmin, real amax, real amin) {
+    real top_speed = sign(task_displacement)*sqrt(2*std::abs(task_displacement)/(std::abs(1/amax) + std::abs(1/amin)));
 
-    for (int i = 0; i < manip.joints; i++) {
-        real start_pos = task(i, 0);
-        real end_pos = task(i, 3);
+    if (top_speed > vmax) {
+        real t1 = std::abs(vmax / amax);
+        real t2 = std::abs(vmax / amin);
+        
+        real d1 = std::abs(0.5*amax * t1 * t1);
+        real d2 = std::abs(0.5*amin * t2 * t2);
 
-        real task_displacement = end_pos - start_pos;
+        real d_mid = task_displacement - d1 - d2;
 
-        real top_speed = sign(task_displacement)*sqrt(2*std::abs(task_displacement)/(std::abs(1/manip.amax[i]) + std::abs(1/manip.amin[i])));
+        real t_mid = d_mid / vmax;
+        return t_mid + t1 + t2;
+    } else if (top_speed < vmin) {
+        real t1 = std::abs(vmin / amin);
+        real t2 = std::abs(vmin / amax);
+        
+        real d1 = std::abs(0.5*amin * t1 * t1);
+        real d2 = std::abs(0.5*amax * t2 * t2);
 
-        if (top_speed > manip.vmax[i]) {
-            real t1 = std::abs(manip.vmax[i] / manip.amax[i]);
-            real t2 = std::abs(manip.vmax[i] / manip.amin[i]);
-            
-            real d1 = std::abs(0.5*manip.amax[i] * t1 * t1);
-            real d2 = std::abs(0.5*manip.amin[i] * t2 * t2);
+        real d_mid = task_displacement + d1 + d2;
 
-            real d_mid = task_displacement - d1 - d2;
+        real t_mid = d_mid / vmin;
+        return t_mid + t1 + t2;
+    } else {
+        real t1 = std::abs(top_speed / amax);
+        real t2 = std::abs(top_speed / amin);
+        return t1 + t2;
+    }
+}
 
-            real t_mid = d_mid / manip.vmax[i];
-            times[i] = t_mid + t1 + t2;
-        } else if (top_speed < manip.vmin[i]) {
-            real t1 = std::abs(manip.vmin[i] / manip.amin[i]);
-            real t2 = std::abs(manip.vmin[i] / manip.amax[i]);
-            
-            real d1 = std::abs(0.5*manip.amin[i] * t1 * t1);
-            real d2 = std::abs(0.5*manip.amax[i] * t2 * t2);
+// todo: Adapt for velocity different than 0
+inline real trapezoidal_velocity_profile_time(Matrix task, GenericManipulator manip) {
+    Array times(manip.joints);
 
-            real d_mid = task_displacement + d1 + d2;
+    for (int i = 0; i < manip.joints; i++) {
+        real start_pos = task(i, 0);
+        real end_pos = task(i, 3);
 
-            real t_mid = d_mid / manip.vmin[i];
-            times[i] = t_mid + t1 + t2;
-        } else {
-            real t1 = std::abs(top_speed / manip.amax[i]);
-            real t2 = std::abs(top_speed / manip.amin[i]);
-            times[i] = t1 + t2;
-        }
+        times[i] = trapezoidal_velocity_profile_time(end_pos - start_pos, manip.vmax[i], manip.vmin[i], manip.amax[i], manip.amin[i]);
     }
 
     return max(times);
@@ -175,42 +182,22 @@ inline real trapezoidal_velocity_profile_time(JointTask task, GenericManipulator
         // real start_vel = task.start_velocity[i];
         // real end_vel = task.end_velocity[i];
 
-        real task_displacement = end_pos - start_pos;
-
-        real top_speed = sign(task_displacement)*sqrt(2*std::abs(task_displacement)/(std::abs(1/manip.amax[i]) + std::abs(1/manip.amin[i])));
-
-        if (top_speed > manip.vmax[i]) {
-            real t1 = std::abs(manip.vmax[i] / manip.amax[i]);
-            real t2 = std::abs(manip.vmax[i] / manip.amin[i]);
-            
-            real d1 = std::abs(0.5*manip.amax[i] * t1 * t1);
-            real d2 = std::abs(0.5*manip.amin[i] * t2 * t2);
-
-            real d_mid = task_displacement - d1 - d2;
-
-            real t_mid = d_mid / manip.vmax[i];
-            times[i] = t_mid + t1 + t2;
-        } else if (top_speed < manip.vmin[i]) {
-            real t1 = std::abs(manip.vmin[i] / manip.amin[i]);
-            real t2 = std::abs(manip.vmin[i] / manip.amax[i]);
-            
-            real d1 = std::abs(0.5*manip.amin[i] * t1 * t1);
-            real d2 = std::abs(0.5*manip.amax[i] * t2 * t2);
-
-            real d_mid = task_displacement + d1 + d2;
-
-            real t_mid = d_mid / manip.vmin[i];
-            times[i] = t_mid + t1 + t2;
-        } else {
-            real t1 = std::abs(top_speed / manip.amax[i]);
-            real t2 = std::abs(top_speed / manip.amin[i]);
-            times[i] = t1 + t2;
-        }
+        times[i] = trapezoidal_velocity_profile_time(end_pos - start_pos, manip.vmax[i], manip.vmin[i], manip.amax[i], manip.amin[i]);
     }
 
     return max(times);
 }
 
+// Same as above on contiguous joint positions, without any allocation
+inline real trapezoidal_velocity_profile_time(const real* start_pos, const real* end_pos, const GenericManipulator& manip) {
+    real time = 0;
+    for (int i = 0; i < manip.joints; i++) {
+        real joint_time = trapezoidal_velocity_profile_time(end_pos[i] - start_pos[i], manip.vmax[i], manip.vmin[i], manip.amax[i], manip.amin[i]);
+        time = joint_time > time ? joint_time : time;
+    }
+    return time;
+}
+
 struct TaskSequencingProblem {
     std::vector<OrderConstraint> order_constraints;
     std::vector<DomainConstraint> domain_constraints;
@@ -234,6 +221,14 @@ struct TaskSequencingProblem {
     Matrix cost = {};
     Array minimum_cost_to_reach = {};
 
+    // Cost of moving between tasks, null keeps the rest to rest trapezoidal_velocity_profile_time()
+    std::shared_ptr<CostModel> cost_model = nullptr;
+
+    // Keep the motion computed for every cost (needs cost_model), see extract_motion_profiles()
+    bool cache_profiles = false;
+    std::vector<MotionProfile> profiles = {}; // Motion of cost(row, col) at [row*n_tasks + col]
+    std::vector<MotionProfile> profiles_from_start = {};
+
     TaskSequencingProblem(GenericManipulator new_manip) 
         : manip(new_manip) {}
 
@@ -378,6 +373,7 @@ struct TaskSequencingProblem {
         }
 
         void setup(const World& world) {
+            TRACE_ZONE("setup");
             working_set.clear();
             int n_joints = manip.joints;
 
@@ -426,7 +422,35 @@ struct TaskSequencingProblem {
             cost_from_start.resize(n_tasks);
             minimum_cost_to_reach.resize(n_tasks);
 
+            bool keep_profiles = cost_model && cache_profiles;
+            profiles.clear();
+            profiles_from_start.clear();
+            if (keep_profiles) {
+                profiles.resize((size_t)n_tasks*n_tasks);
+                profiles_from_start.resize(n_tasks);
+            }
+
             Matrix current_task(manip.joints, 6);
+            TRACE_ZONE_NAMED(costs_zone, "setup costs");
+
+            // Cost models with a batched kernel evaluate a whole row at once, against the start positions of every task
+            // laid out joint by joint (joint q of task k at [q*n_tasks + k]). Profiles need evaluate() pair by pair.
+            std::vector<real> target_positions;
+            std::vector<real> batch_costs;
+            bool batched = false;
+            if (cost_model && !keep_profiles) {
+                target_positions.assign((size_t)n_joints*n_tasks, 0);
+                batch_costs.resize(n_tasks);
+                for (int k = 0; k < n_tasks; k++) {
+                    for (int q = 0; q < n_joints && q < working_set[k].start_position.size; q++) {
+                        target_positions[(size_t)q*n_tasks + k] = working_set[k].start_position[q];
+                    }
+                }
+                batched = cost_model->evaluate_batch(start_position, target_positions.data(), n_tasks, manip, batch_costs.data());
+                for (int k = 0; batched && k < n_tasks; k++) {
+                    cost_from_start[k] = batch_costs[k];
+                }
+            }
 
             // Evaluate the cost matrix and the minimum cost to reach, which is used in the h() value (optimal cost estimate from a specific state)
             for (int i = 0; i < n_tasks; i++) {
@@ -447,12 +471,19 @@ struct TaskSequencingProblem {
                     current_task(j, 3) = working_set[i].start_position[j];
                 }
 
-                cost_from_start[i] = trapezoidal_velocity_profile_time(current_task, manip);
+                if (cost_model && !batched) {
+                    cost_from_start[i] = cost_model->evaluate(start_position, {}, working_set[i].start_position, working_set[i].start_velocity, manip, keep_profiles ? &profiles_from_start[i] : nullptr);
+                } else if (!cost_model) {
+                    cost_from_start[i] = trapezoidal_velocity_profile_time(current_task, manip);
+                }
 
                 // Fill mcost matrix
                 for (int j = 0; j < current_task.cols; j++) {
                     current_task(j, 0) = working_set[i].end_position[j];
                 }
+                if (batched) {
+                    cost_model->evaluate_batch(working_set[i].end_position, target_positions.data(), n_tasks, manip, batch_costs.data());
+                }
                 real current_min_cost = INF_REAL;
                 for (int j = 0; j < n_tasks; j++) {
                     if (working_set[i].task_id == working_set[j].task_id) {
@@ -462,12 +493,19 @@ struct TaskSequencingProblem {
                         for (int r = 0; r < current_task.cols; r++) {
                             current_task(r, 3) = working_set[j].start_position[r];
                         }
-                        cost(j, i) = trapezoidal_velocity_profile_time(current_task, manip);
+                        if (batched) {
+                            cost(j, i) = batch_costs[j];
+                        } else if (cost_model) {
+                            cost(j, i) = cost_model->evaluate(working_set[i].end_position, working_set[i].end_velocity, working_set[j].start_position, working_set[j].start_velocity, manip, keep_profiles ? &profiles[(size_t)j*n_tasks + i] : nullptr);
+                        } else {
+                            cost(j, i) = trapezoidal_velocity_profile_time(current_task, manip);
+                        }
                         current_min_cost = cost(j, i) < current_min_cost ? cost(j, i) : current_min_cost;
                     }
                 }
                 minimum_cost_to_reach[i] = current_min_cost;
             }
+            TRACE_ZONE_END(costs_zone);
             
             // Constrict domains according to domain constraints
             task_domain.resize(n_tasks, n_tasks);
@@ -0,0 +1,272 @@
+#pragma once
+#include "task.hpp"
+#include <utility>
+
+// Streaming alternative to TaskSequencingProblem::add_task() + setup() for very large working sets.
+// Tasks enter the working set as they arrive and their cost rows and columns are computed right away, instead of being
+// copied into tasks, joint_space_tasks and then working_set: each task is moved once, and the cost kernels read its
+// positions there rather than from another copy. The cost matrix is allocated once for the expected working
+// set size, and finish() moves it and the working set into a TaskSequencingProblem that is ready for A_star() (do not
+// call setup() on it).
+// note: Past the expected size the cost matrix is reallocated twice as large, which holds both for a moment, and
+// finish() then copies it down to the final size. Give the exact size to avoid both.
+// note: Costs come from cost_model like in setup(), evaluated pair by pair as tasks arrive (the batched kernels need
+// every target upfront). Motion profiles are not kept, cache_profiles has no effect on a streamed problem.
+struct TaskStream {
+    GenericManipulator manip;
+    Array start_position = {};
+    int n_joints = 0;
+    std::shared_ptr<CostModel> cost_model = nullptr; // Null keeps the rest to rest trapezoidal_velocity_profile_time()
+
+    std::vector<JointTask> working_set;
+
+    // Same meaning as TaskSequencingProblem::cost, capacity rows and columns of which the first size() are used
+    Matrix cost = {};
+    std::vector<real> cost_from_start;
+    std::vector<real> minimum_cost_to_reach;
+    int capacity = 0;
+
+    std::vector<OrderConstraint> order_constraints;
+    std::vector<DomainConstraint> domain_constraints;
+    std::vector<FollowingConstraint> following_constraints;
+
+    int n_joint_space_tasks = 0;
+    int n_cartesian_space_tasks = 0;
+
+    TaskStream(GenericManipulator new_manip, Array new_start_position, int expected_working_set_size = 0, std::shared_ptr<CostModel> new_cost_model = nullptr)
+        : manip(new_manip), start_position(new_start_position), n_joints(new_manip.joints), cost_model(new_cost_model) {
+            Assert(start_position.size == n_joints);
+            reserve(expected_working_set_size);
+        }
+
+    int size() const { return working_set.size(); }
+
+    // Same id as TaskSequencingProblem::add_task() would give, -1 when the task does not match the manipulator
+    int add_task(JointTask&& new_task) {
+        int task_id = n_joint_space_tasks + n_cartesian_space_tasks;
+        new_task.task_id = task_id;
+        if (!push(std::move(new_task))) {
+            return -1;
+        }
+        n_joint_space_tasks++;
+        return task_id;
+    }
+
+    // IK solutions are computed right away, each one enters the working set like in setup()
+    int add_task(CartesianTask&& new_task, const World& world) {
+        int task_id = n_joint_space_tasks + n_cartesian_space_tasks;
+        // Ids of end positions come after every task id, which is unknown until finish(). Until then they get
+        // a negative placeholder, so that costs between solutions of the same end position are still 0.
+        int end_task_id = -(n_cartesian_space_tasks + 1);
+        n_cartesian_space_tasks++;
+        cartesian_start_ids.push_back(task_id);
+
+        new_task.get_all_IK(world);
+        for (const auto& solution : new_task.start_joint_solutions) {
+            push(solution_task(task_id, solution));
+        }
+        for (const auto& solution : new_task.end_joint_solutions) {
+            push(solution_task(end_task_id, solution));
+        }
+        return task_id;
+    }
+
+    void add_order_constraint(const int earlier_task, const int later_task) {
+        // Not using Assert() because user will very likely be using this function and the error message is important.
+        check_task_id(earlier_task);
+        check_task_id(later_task);
+
+        OrderConstraint new_constraint;
+        new_constraint.earlier = earlier_task;
+        new_constraint.later = later_task;
+        order_constraints.push_back(new_constraint);
+    }
+
+    void add_following_constraint(const int earlier_task, const int later_task) {
+        check_task_id(earlier_task);
+        check_task_id(later_task);
+
+        FollowingConstraint new_constraint;
+        new_constraint.earlier = earlier_task;
+        new_constraint.later = later_task;
+        following_constraints.push_back(new_constraint);
+    }
+
+    void add_domain_constraint(const int task_id, const Array& domain) {
+        check_task_id(task_id);
+
+        DomainConstraint new_constraint;
+        new_constraint.task_id = task_id;
+        new_constraint.domain = domain;
+        domain_constraints.push_back(new_constraint);
+    }
+
+    // Moves everything into problem, the stream is left empty. The problem gets the cost model of the stream, returns
+    // false and leaves both untouched when it already has another one.
+    bool finish(TaskSequencingProblem& problem) {
+        if (problem.cost_model && problem.cost_model != cost_model) {
+            std::cerr << "Error : The problem has a cost model other than the one of the stream, its costs would not match" << std::endl;
+            return false;
+        }
+        int n_tasks = size();
+        int n_task_ids = n_joint_space_tasks + n_cartesian_space_tasks;
+
+        // Resolve cartesian end position ids, as setup() numbers them
+        for (auto& task : working_set) {
+            if (task.task_id < 0) {
+                task.task_id = n_task_ids - task.task_id - 1;
+            }
+        }
+
+        if (n_tasks != capacity) {
+            Matrix fitted(n_tasks, n_tasks);
+            for (int i = 0; i < n_tasks; i++) {
+                for (int j = 0; j < n_tasks; j++) {
+                    fitted(i, j) = cost(i, j);
+                }
+            }
+            cost = std::move(fitted);
+        }
+        problem.cost = std::move(cost);
+        problem.working_set = std::move(working_set);
+        problem.cost_model = cost_model;
+        problem.profiles.clear();
+        problem.profiles_from_start.clear();
+
+        problem.cost_from_start = Array(n_tasks);
+        problem.minimum_cost_to_reach = Array(n_tasks);
+        for (int i = 0; i < n_tasks; i++) {
+            problem.cost_from_start[i] = cost_from_start[i];
+            problem.minimum_cost_to_reach[i] = minimum_cost_to_reach[i];
+        }
+
+        problem.task_domain.resize(n_tasks, n_tasks);
+        for (int i = 0; i < n_tasks; i++) {
+            for (int j = 0; j < n_tasks; j++) {
+                problem.task_domain(i, j) = 1;
+            }
+        }
+        for (const auto& constraint : domain_constraints) {
+            for (int j = 0; j < constraint.domain.size; j++) {
+                problem.task_domain(constraint.task_id, j) = constraint.domain[j];
+            }
+        }
+
+        // Every cartesian task is followed by its end position, like in setup()
+        problem.phantom_following_constraints.clear();
+        for (int i = 0; i < cartesian_start_ids.size(); i++) {
+            FollowingConstraint new_constraint;
+            new_constraint.earlier = cartesian_start_ids[i];
+            new_constraint.later = n_task_ids + i;
+            problem.phantom_following_constraints.push_back(new_constraint);
+        }
+
+        problem.start_position = start_position;
+        problem.order_constraints = std::move(order_constraints);
+        problem.following_constraints = std::move(following_constraints);
+        problem.domain_constraints = std::move(domain_constraints);
+
+        // A_star() counts clusters from the task lists
+        problem.tasks.clear();
+        problem.joint_space_tasks.assign(n_joint_space_tasks, JointTask());
+        problem.cartesian_space_tasks.assign(n_cartesian_space_tasks, CartesianTask());
+
+        *this = TaskStream(manip, start_position, 0, cost_model);
+        return true;
+    }
+
+    private:
+        std::vector<int> cartesian_start_ids;
+
+        void reserve(int new_capacity) {
+            if (new_capacity <= capacity) {
+                return;
+            }
+            working_set.reserve(new_capacity);
+            cost_from_start.reserve(new_capacity);
+            minimum_cost_to_reach.reserve(new_capacity);
+
+            Matrix new_cost(new_capacity, new_capacity);
+            for (int i = 0; i < size(); i++) {
+                for (int j = 0; j < size(); j++) {
+                    new_cost(i, j) = cost(i, j);
+                }
+            }
+            cost = std::move(new_cost);
+            capacity = new_capacity;
+        }
+
+        // Task standing still at an IK solution
+        static JointTask solution_task(int task_id, const Array& solution) {
+            JointTask task;
+            task.task_id = task_id;
+            task.start_position = solution;
+            task.end_position = solution;
+            return task;
+        }
+
+        // Missing velocities and accelerations are zero, like in add_joint_space_task()
+        bool push(JointTask&& task) {
+            // Not formulated as Assert() because this function will be used and feedback is important
+            auto valid = [&](const Array& values, bool optional) { return values.size == n_joints || (optional && values.size == 0); };
+            if (!valid(task.start_position, false) || !valid(task.end_position, false) ||
+                !valid(task.start_velocity, true) || !valid(task.end_velocity, true) ||
+                !valid(task.start_acceleration, true) || !valid(task.end_acceleration, true)) {
+                std::cerr << "Error : Task id " << task.task_id << " contains at least one parameter (pos, vel, acc) inconsistent with manipulator number of joints" << std::endl;
+                return false;
+            }
+            for (Array* values : {&task.start_velocity, &task.end_velocity, &task.start_acceleration, &task.end_acceleration}) {
+                if (values->size == 0) {
+                    *values = Array(n_joints);
+                }
+            }
+            if (size() == capacity) {
+                reserve(capacity == 0 ? 16 : 2*capacity);
+            }
+
+            int k = size();
+            int task_id = task.task_id;
+            working_set.push_back(std::move(task));
+
+            const JointTask& k_task = working_set.back();
+            const real* k_start = &k_task.start_position[0];
+            const real* k_end = &k_task.end_position[0];
+            if (cost_model) {
+                cost_from_start.push_back(cost_model->evaluate(start_position, {}, k_task.start_position, k_task.start_velocity, manip));
+            } else {
+                cost_from_start.push_back(trapezoidal_velocity_profile_time(&start_position[0], k_start, manip));
+            }
+
+            // Fill row and column k against every task already in the stream
+            real k_min_cost = INF_REAL;
+            cost(k, k) = 0;
+            for (int i = 0; i < k; i++) {
+                real& to_k = cost(k, i);   // from end of i to start of k
+                real& from_k = cost(i, k); // from end of k to start of i
+                if (working_set[i].task_id == task_id) {
+                    to_k = 0;
+                    from_k = 0;
+                    continue;
+                }
+                if (cost_model) {
+                    const JointTask& i_task = working_set[i];
+                    to_k = cost_model->evaluate(i_task.end_position, i_task.end_velocity, k_task.start_position, k_task.start_velocity, manip);
+                    from_k = cost_model->evaluate(k_task.end_position, k_task.end_velocity, i_task.start_position, i_task.start_velocity, manip);
+                } else {
+                    to_k = trapezoidal_velocity_profile_time(&working_set[i].end_position[0], k_start, manip);
+                    from_k = trapezoidal_velocity_profile_time(k_end, &working_set[i].start_position[0], manip);
+                }
+
+                minimum_cost_to_reach[i] = to_k < minimum_cost_to_reach[i] ? to_k : minimum_cost_to_reach[i];
+                k_min_cost = from_k < k_min_cost ? from_k : k_min_cost;
+            }
+            minimum_cost_to_reach.push_back(k_min_cost);
+            return true;
+        }
+
+        void check_task_id(const int task_id) {
+            if (task_id < 0 || task_id >= n_joint_space_tasks + n_cartesian_space_tasks) {
+                std::cerr << "Error : Task id " << task_id << " is undefined" << std::endl;
+            }
+        }
+};
@@ -5,6 +5,7 @@
 #include "../extern/blast_rush/tests/test_helper/test_functions.hpp"
 #include "../utilities.hpp"
 #include "../A_star.hpp"
+#include "../solution_cache.hpp"
 
 TEST_CASE("test extract_solution() function", "[A_star]") {
     Node n1;
@@ -264,3 +265,243 @@ TEST_CASE("test A_star() function with cartesian with domain constraints", "[A_s
     CHECK(success);
     CHECK(is_close(expected_solution, solution));
 }
+
+TEST_CASE("test extract_motion_profiles() function", "[A_star]") {
+    auto manip = get_generic_Link6();
+    World world;
+    auto demo1_tasks = get_Link6_demo1_tasks_simple();
+    
+    TaskSequencingProblem example_task(manip);
+
+    for (int i = 0; i < demo1_tasks.size(); i++) {
+        example_task.add_task(Task(demo1_tasks[i]));
+    }
+
+    example_task.start_position = get_Link6_home();
+    example_task.cost_model = std::make_shared<TrapezoidalCostModel>();
+    example_task.cache_profiles = true;
+    example_task.setup(world);
+
+    bool success = false;
+    auto solution = A_star(example_task, &success);
+    REQUIRE(success);
+
+    auto motions = extract_motion_profiles(example_task, solution);
+    REQUIRE(motions.size() == solution.size);
+
+    // Each motion starts where the previous task ended
+    Array position, velocity, acceleration;
+    motions[0].sample(0, position, velocity, acceleration);
+    CHECK(is_close(position, example_task.start_position, 1e-6));
+    for (int i = 0; i < solution.size; i++) {
+        motions[i].sample(motions[i].duration, position, velocity, acceleration);
+        CHECK(is_close(position, example_task.working_set[solution[i]].start_position, 1e-6));
+        if (i > 0) {
+            motions[i].sample(0, position, velocity, acceleration);
+            CHECK(is_close(position, example_task.working_set[solution[i-1]].end_position, 1e-6));
+        }
+    }
+}
+
+// Solution cache
+
+TEST_CASE("test problem_fingerprint() function", "[A_star]") {
+    auto manip = get_generic_Link6();
+    auto demo1_tasks = get_Link6_demo1_tasks_simple();
+
+    TaskSequencingProblem example_task(manip);
+
+    for (int i = 0; i < demo1_tasks.size(); i++) {
+        example_task.add_task(Task(demo1_tasks[i]));
+    }
+
+    example_task.start_position = get_Link6_home();
+
+    auto same_task = example_task;
+    auto constrained_task = example_task;
+    auto moved_task = example_task;
+
+    constrained_task.add_order_constraint(0, 1);
+    moved_task.tasks[2].joint_task.end_position[0] += 0.1;
+
+    auto fingerprint = problem_fingerprint(example_task, 1e-3);
+
+    CHECK(fingerprint == problem_fingerprint(same_task, 1e-3));
+    CHECK(fingerprint != problem_fingerprint(constrained_task, 1e-3));
+    CHECK(fingerprint != problem_fingerprint(moved_task, 1e-3));
+
+    // The cost model and its parameters
+    auto trapezoidal_task = example_task;
+    auto s_curve_task = example_task;
+    auto other_s_curve_task = example_task;
+    auto profiled_task = example_task;
+
+    trapezoidal_task.cost_model = std::make_shared<TrapezoidalCostModel>();
+    s_curve_task.cost_model = std::make_shared<SCurveCostModel>(Array(manip.joints, 10.0));
+    other_s_curve_task.cost_model = std::make_shared<SCurveCostModel>(Array(manip.joints, 20.0));
+    profiled_task.cache_profiles = !example_task.cache_profiles;
+
+    auto trapezoidal_fingerprint = problem_fingerprint(trapezoidal_task, 1e-3);
+    auto s_curve_fingerprint = problem_fingerprint(s_curve_task, 1e-3);
+
+    CHECK(fingerprint != trapezoidal_fingerprint);
+    CHECK(fingerprint != s_curve_fingerprint);
+    CHECK(trapezoidal_fingerprint != s_curve_fingerprint);
+    CHECK(s_curve_fingerprint != problem_fingerprint(other_s_curve_task, 1e-3));
+    CHECK(fingerprint != problem_fingerprint(profiled_task, 1e-3));
+
+    s_curve_task.cost_model = std::make_shared<SCurveCostModel>(Array(manip.joints, 10.0));
+    CHECK(s_curve_fingerprint == problem_fingerprint(s_curve_task, 1e-3));
+}
+
+TEST_CASE("test A_star_cached() function", "[A_star]") {
+    auto manip = get_generic_Link6();
+    World world;
+    auto demo1_tasks = get_Link6_demo1_tasks_simple();
+
+    TaskSequencingProblem example_task(manip);
+
+    for (int i = 0; i < demo1_tasks.size(); i++) {
+        example_task.add_task(Task(demo1_tasks[i]));
+    }
+
+    example_task.start_position = get_Link6_home();
+    example_task.add_order_constraint(0, 1);
+
+    auto resubmitted_task = example_task;
+
+    SolutionCache cache(2);
+    bool success = false;
+    auto solution = A_star_cached(cache, example_task, world, &success);
+
+    Array expected_solution = {3.0, 5.0, 0.0, 4.0, 1.0, 2.0};
+
+    CHECK(success);
+    CHECK(is_close(expected_solution, solution));
+    CHECK(cache.misses == 1);
+
+    success = false;
+    std::vector<std::vector<Array>> joint_space_solution;
+    solution = A_star_cached(cache, resubmitted_task, world, &success, &joint_space_solution);
+
+    CHECK(success);
+    CHECK(is_close(expected_solution, solution));
+    CHECK(cache.hits == 1);
+    CHECK(joint_space_solution.size() == demo1_tasks.size());
+    CHECK(resubmitted_task.working_set.size() == 0); // setup() was skipped
+
+    // Only the cost model changes: the trapezoidal solution must not be returned
+    auto s_curve_task = resubmitted_task;
+    s_curve_task.cost_model = std::make_shared<SCurveCostModel>(Array(manip.joints, 10.0));
+    A_star_cached(cache, s_curve_task, world, &success);
+
+    CHECK(cache.misses == 2);
+    CHECK(cache.hits == 1);
+    CHECK(s_curve_task.working_set.size() == demo1_tasks.size()); // setup() ran
+
+    // Persist and reload
+    std::string path = "test_solution_cache.bin";
+    CHECK(cache.save(path));
+
+    SolutionCache loaded_cache;
+    CHECK(loaded_cache.load(path));
+    auto cached = loaded_cache.find(problem_fingerprint(resubmitted_task));
+    REQUIRE(cached != nullptr);
+    CHECK(cached->success);
+    CHECK(is_close(expected_solution, cached->solution));
+    std::remove(path.c_str());
+}
+
+TEST_CASE("test SolutionCache load() function with corrupt files", "[A_star]") {
+    SolutionCache cache;
+    CachedSolution entry;
+    entry.key = 42;
+    entry.success = true;
+    entry.solution = {1.0, 0.0};
+    entry.joint_space_solution = {{Array(6, 0.5), Array(6, 1.5)}, {Array(6, 2.5)}};
+    cache.insert(entry);
+
+    std::string path = "test_corrupt_cache.bin";
+    REQUIRE(cache.save(path));
+    std::string content;
+    {
+        std::ifstream file(path, std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    auto write_file = [&](const std::string& bytes) {
+        std::ofstream file(path, std::ios::binary);
+        file.write(bytes.data(), bytes.size());
+    };
+    SolutionCache loaded_cache;
+
+    // Every truncation is rejected
+    for (size_t size = 0; size < content.size(); size += 7) {
+        write_file(content.substr(0, size));
+        CHECK_FALSE(loaded_cache.load(path));
+    }
+    write_file(content);
+    CHECK(loaded_cache.load(path));
+    CHECK(loaded_cache.entries.size() == 1);
+
+    // Huge counts are rejected before anything is allocated
+    auto corrupted = content;
+    uint64_t n_entries = uint64_t(1) << 60;
+    std::memcpy(&corrupted[16], &n_entries, sizeof(n_entries));
+    write_file(corrupted);
+    CHECK_FALSE(loaded_cache.load(path));
+
+    corrupted = content;
+    int32_t size = std::numeric_limits<int32_t>::max();
+    std::memcpy(&corrupted[24 + sizeof(uint64_t) + sizeof(uint8_t)], &size, sizeof(size));
+    write_file(corrupted);
+    CHECK_FALSE(loaded_cache.load(path));
+
+    corrupted = content;
+    size_t positions_offset = 24 + sizeof(uint64_t) + sizeof(uint8_t) + sizeof(int32_t) + 2*sizeof(real);
+    std::memcpy(&corrupted[positions_offset], &size, sizeof(size));
+    write_file(corrupted);
+    CHECK_FALSE(loaded_cache.load(path));
+
+    corrupted = content;
+    std::memcpy(&corrupted[positions_offset + sizeof(int32_t)], &size, sizeof(size));
+    write_file(corrupted);
+    CHECK_FALSE(loaded_cache.load(path));
+
+    CHECK(loaded_cache.entries.size() == 1);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("test A_star() function with a SearchControl", "[A_star]") {
+    auto manip = get_generic_Link6();
+    World world;
+    auto demo1_tasks = get_Link6_demo1_tasks_simple();
+
+    TaskSequencingProblem example_task(manip);
+    for (int i = 0; i < demo1_tasks.size(); i++) {
+        example_task.add_task(Task(demo1_tasks[i]));
+    }
+    example_task.start_position = get_Link6_home();
+    example_task.setup(world);
+
+    SearchControl control;
+    bool success = false;
+    auto solution = A_star(example_task, &success, nullptr, &control);
+    Array expected_solution = {3.0, 5.0, 4.0, 1.0, 2.0, 0.0};
+    CHECK(success);
+    CHECK(is_close(expected_solution, solution));
+    CHECK(control.status == SearchStatus::finished);
+    CHECK(control.n_nodes >= 6);
+    CHECK(control.best_bound > 0);
+
+    control.node_budget = 2;
+    solution = A_star(example_task, &success, nullptr, &control);
+    CHECK_FALSE(success);
+    CHECK(control.status == SearchStatus::out_of_nodes);
+    control.node_budget = -1;
+
+    control.cancel();
+    solution = A_star(example_task, &success, nullptr, &control);
+    CHECK_FALSE(success);
+    CHECK(control.status == SearchStatus::cancelled);
+    CHECK(control.n_nodes == 1);
+}
@@ -0,0 +1,808 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+#include "../constraints_satisfaction_problem.hpp"
+#include "../csp_local_search.hpp"
+#include "../csp_parallel.hpp"
+#include <numeric>
+#include <random>
+#include <vector>
+
+// Same model as test/assn04.cpp
+struct NQueensDomain : CSP_Domain {
+    NQueensDomain(int n_queens) : CSP_Domain(n_queens) {
+        for (int i = 0; i < n_queens; i++) {
+            insert(i);
+        }
+    }
+};
+
+struct NQueensVariable : CSP_Variable {
+    int col;
+    NQueensVariable(int pos, int n_queens) :
+        col(pos)
+     {
+        domain = NQueensDomain(n_queens);
+     }
+};
+
+struct NQueensConstraint : CSP_Constraint {
+    NQueensConstraint(NQueensVariable& var_1, NQueensVariable& var_2) {
+        input_var = {&var_1};
+        output_var = {&var_2};
+        var_1.from_arcs.push_back(this);
+        var_2.to_arcs.push_back(this);
+    }
+
+    bool func(int col_1, int row_1, int col_2, int row_2) {
+        return row_1 != row_2 && row_2 - row_1 != col_2 - col_1 && row_1 - row_2 != col_2 - col_1;
+    }
+
+    bool consistent(CSP_Assignment a, int x) override {
+        auto* var1 = static_cast<NQueensVariable*>(input_var[0]);
+        auto* var2 = static_cast<NQueensVariable*>(output_var[0]);
+        return func(var1->col, a[var1->col], var2->col, x);
+    }
+};
+
+struct NQueens : CSP {
+    NQueens(int n_queens) {
+        variables.resize(n_queens);
+        for (int i = 0; i < n_queens; i++) {
+            variables[i] = std::make_unique<NQueensVariable>(i, n_queens);
+        }
+        for (int i = 0; i < n_queens-1; i++) {
+            for (int j = i+1; j < n_queens; j++) {
+                auto var1 = static_cast<NQueensVariable*>(variables[i].get());
+                auto var2 = static_cast<NQueensVariable*>(variables[j].get());
+                constraints.push_back(std::make_unique<NQueensConstraint>(*var1, *var2));
+            }
+        }
+    }
+};
+
+// x < y between two variables
+struct LessThanConstraint : CSP_Constraint {
+    LessThanConstraint(CSP_Variable& var_1, CSP_Variable& var_2) {
+        input_var = {&var_1};
+        output_var = {&var_2};
+        var_1.from_arcs.push_back(this);
+        var_2.to_arcs.push_back(this);
+    }
+
+    bool consistent(CSP_Assignment a, int x) override {
+        return a[input_var[0]->idx] < x;
+    }
+};
+
+// x + y = z, inputs x and y
+struct SumConstraint : CSP_Constraint {
+    SumConstraint(CSP_Variable& x, CSP_Variable& y, CSP_Variable& z) {
+        input_var = {&x, &y};
+        output_var = {&z};
+        x.from_arcs.push_back(this);
+        y.from_arcs.push_back(this);
+        z.to_arcs.push_back(this);
+    }
+
+    bool consistent(CSP_Assignment a, int z) override {
+        return a[input_var[0]->idx] + a[input_var[1]->idx] == z;
+    }
+};
+
+// Chain x_0 < x_1 < ... < x_{n-1}, every domain is [0, n_values)
+struct LessThanChain : CSP {
+    LessThanChain(int n_variables, int n_values) {
+        for (int i = 0; i < n_variables; i++) {
+            variables.push_back(std::make_unique<CSP_Variable>());
+            variables[i]->domain = CSP_Domain(n_values, true);
+        }
+        for (int i = 0; i+1 < n_variables; i++) {
+            constraints.push_back(std::make_unique<LessThanConstraint>(*variables[i], *variables[i+1]));
+        }
+    }
+};
+
+// x != y between two variables
+struct NotEqualConstraint : CSP_Constraint {
+    NotEqualConstraint(CSP_Variable& var_1, CSP_Variable& var_2) {
+        input_var = {&var_1};
+        output_var = {&var_2};
+        var_1.from_arcs.push_back(this);
+        var_2.to_arcs.push_back(this);
+    }
+
+    bool consistent(CSP_Assignment a, int x) override {
+        return a[input_var[0]->idx] != x;
+    }
+};
+
+// Random sparse graph with n_colors colors, edges only join vertices of different colors of a hidden coloring so that
+// the problem is satisfiable. Edges go from the smaller to the larger vertex, as input ordering requires.
+struct GraphColoring : CSP {
+    std::vector<std::pair<int, int>> edges;
+
+    GraphColoring(int n_vertices, int n_edges, int n_colors, unsigned seed) {
+        std::mt19937 rng(seed);
+        std::vector<int> hidden(n_vertices);
+        for (int i = 0; i < n_vertices; i++) {
+            hidden[i] = rng() % n_colors;
+            variables.push_back(std::make_unique<CSP_Variable>());
+            variables[i]->domain = CSP_Domain(n_colors, true);
+        }
+        while (edges.size() < n_edges) {
+            int u = rng() % n_vertices;
+            int v = rng() % n_vertices;
+            if (hidden[u] != hidden[v]) {
+                edges.push_back({std::min(u, v), std::max(u, v)});
+                constraints.push_back(std::make_unique<NotEqualConstraint>(*variables[edges.back().first], *variables[edges.back().second]));
+            }
+        }
+    }
+
+    bool is_solution(const std::vector<int>& colors) const {
+        if (colors.size() != variables.size()) {
+            return false;
+        }
+        for (const auto& edge : edges) {
+            if (colors[edge.first] == colors[edge.second]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Same problem as NQueens with three all-different constraints: rows, and both diagonals through offsets
+struct NQueensGlobal : CSP {
+    NQueensGlobal(int n_queens) {
+        std::vector<CSP_Variable*> scope;
+        std::vector<int> up(n_queens);
+        std::vector<int> down(n_queens);
+        for (int i = 0; i < n_queens; i++) {
+            variables.push_back(std::make_unique<CSP_Variable>());
+            variables[i]->domain = NQueensDomain(n_queens);
+            scope.push_back(variables[i].get());
+            up[i] = i;
+            down[i] = n_queens - i;
+        }
+        global_constraints.push_back(std::make_unique<CSP_AllDifferent>(scope));
+        global_constraints.push_back(std::make_unique<CSP_AllDifferent>(scope, up));
+        global_constraints.push_back(std::make_unique<CSP_AllDifferent>(scope, down));
+    }
+};
+
+bool is_n_queens_solution(const std::vector<int>& rows) {
+    for (int i = 0; i < rows.size(); i++) {
+        for (int j = i+1; j < rows.size(); j++) {
+            if (rows[i] == rows[j] || std::abs(rows[i] - rows[j]) == j - i) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+TEST_CASE("CSP_Domain struct function test", "[CSP]") {
+    CSP_Domain domain(130);
+    CHECK(domain.empty());
+    CHECK(domain.first() == -1);
+    CHECK(domain.last() == -1);
+
+    domain.insert(3);
+    domain.insert(64);
+    domain.insert(129);
+    CHECK(domain.size() == 3);
+    CHECK(domain.contains(64));
+    CHECK(!domain.contains(65));
+    CHECK(domain.first() == 3);
+    CHECK(domain.next(3) == 64);
+    CHECK(domain.next(64) == 129);
+    CHECK(domain.next(129) == -1);
+    CHECK(domain.last() == 129);
+
+    domain.erase(64);
+    CHECK(domain.size() == 2);
+    CHECK(domain.next(3) == 129);
+
+    // Grows past capacity
+    domain.insert(200);
+    CHECK(domain.contains(200));
+    CHECK(domain.capacity == 201);
+
+    CSP_Domain full(130, true);
+    CHECK(full.size() == 130);
+    full.intersect(domain);
+    CHECK(full.size() == 2);
+    CHECK(full.first() == 3);
+
+    CSP_FixedDomain<70> fixed(true);
+    CHECK(fixed.size() == 70);
+    fixed.erase(0);
+    CHECK(fixed.first() == 1);
+    CSP_FixedDomain<70> other;
+    other.insert(69);
+    other.insert(5);
+    fixed.intersect(other);
+    CHECK(fixed.size() == 2);
+    CHECK(fixed.next(5) == 69);
+    CHECK(fixed.last() == 69);
+}
+
+TEST_CASE("CSP struct: backtrack() and backtrack_fc() on N-Queens", "[CSP]") {
+    for (int n_queens : {1, 4, 5, 8}) {
+        NQueens problem_1(n_queens);
+        auto solution = problem_1.backtrack();
+        REQUIRE(solution.size() == n_queens);
+        CHECK(is_n_queens_solution(solution));
+
+        NQueens problem_2(n_queens);
+        solution = problem_2.backtrack_fc();
+        REQUIRE(solution.size() == n_queens);
+        CHECK(is_n_queens_solution(solution));
+
+        // Static dispatch follows the same search
+        CHECK(problem_1.backtrack<NQueensConstraint>() == problem_1.backtrack());
+        CHECK(problem_2.backtrack_fc<NQueensConstraint>() == solution);
+    }
+
+    // No solution
+    NQueens problem_3(3);
+    CHECK(problem_3.backtrack().empty());
+    CHECK(problem_3.backtrack_fc().empty());
+
+    // Domains of the variables are left untouched, so a problem can be solved again
+    NQueens problem_4(6);
+    auto first_solution = problem_4.backtrack_fc();
+    CHECK(problem_4.variables[0]->domain.size() == 6);
+    CHECK(problem_4.trail.empty());
+    CHECK(problem_4.backtrack_fc() == first_solution);
+    CHECK(problem_4.backtrack() == first_solution);
+}
+
+TEST_CASE("CSP struct: arc_consistency() function test", "[CSP]") {
+    for (auto propagation : {CSP_Propagation::ac3, CSP_Propagation::ac2001}) {
+        // Each x_i ends up in [i, i + n_values - n_variables]
+        LessThanChain problem_1(4, 6);
+        problem_1.propagation = propagation;
+        CHECK(problem_1.arc_consistency());
+        for (int i = 0; i < 4; i++) {
+            auto& domain = problem_1.variables[i]->domain;
+            CHECK(domain.size() == 3);
+            CHECK(domain.first() == i);
+        }
+
+        LessThanChain problem_2(4, 3);
+        problem_2.propagation = propagation;
+        CHECK(!problem_2.arc_consistency());
+
+        // Pairwise N-Queens constraints are arc consistent from the start
+        NQueens problem_3(6);
+        problem_3.propagation = propagation;
+        CHECK(problem_3.arc_consistency());
+        CHECK(problem_3.variables[0]->domain.size() == 6);
+    }
+}
+
+TEST_CASE("CSP struct: backtrack_mac() on N-Queens", "[CSP]") {
+    for (auto propagation : {CSP_Propagation::ac3, CSP_Propagation::ac2001}) {
+        for (int n_queens : {1, 4, 5, 8, 12}) {
+            NQueens problem_1(n_queens);
+            problem_1.propagation = propagation;
+            auto solution = problem_1.backtrack_mac();
+            REQUIRE(solution.size() == n_queens);
+            CHECK(is_n_queens_solution(solution));
+            CHECK(problem_1.backtrack_mac<NQueensConstraint>() == solution);
+        }
+
+        NQueens problem_2(3);
+        problem_2.propagation = propagation;
+        CHECK(problem_2.backtrack_mac().empty());
+    }
+
+    // Solved by propagation alone
+    LessThanChain problem_3(5, 5);
+    auto solution = problem_3.backtrack_mac();
+    CHECK(solution == std::vector<int>{0, 1, 2, 3, 4});
+}
+
+TEST_CASE("CSP struct: variable and value orderings", "[CSP]") {
+    auto solve = [](CSP& problem, int inference) {
+        if (inference == 0) {
+            return problem.backtrack<NQueensConstraint>();
+        } else if (inference == 1) {
+            return problem.backtrack_fc<NQueensConstraint>();
+        }
+        return problem.backtrack_mac<NQueensConstraint>();
+    };
+    auto variable_orderings = {CSP_VariableOrdering::input, CSP_VariableOrdering::mrv, CSP_VariableOrdering::mrv_degree, CSP_VariableOrdering::dom_wdeg};
+    auto value_orderings = {CSP_ValueOrdering::input, CSP_ValueOrdering::lcv};
+
+    for (int inference = 0; inference < 3; inference++) {
+        for (auto variable_ordering : variable_orderings) {
+            for (auto value_ordering : value_orderings) {
+                for (int n_queens : {1, 4, 8, 13}) {
+                    NQueens problem_1(n_queens);
+                    problem_1.variable_ordering = variable_ordering;
+                    problem_1.value_ordering = value_ordering;
+                    auto solution = solve(problem_1, inference);
+                    REQUIRE(solution.size() == n_queens);
+                    CHECK(is_n_queens_solution(solution));
+                    // Same search again, the state of the previous one is reset
+                    CHECK(solve(problem_1, inference) == solution);
+                }
+
+                NQueens problem_2(3);
+                problem_2.variable_ordering = variable_ordering;
+                problem_2.value_ordering = value_ordering;
+                CHECK(solve(problem_2, inference).empty());
+            }
+        }
+    }
+
+    // Input orderings find the first solution in lexicographic order
+    NQueens problem_3(8);
+    CHECK(problem_3.backtrack_fc() == std::vector<int>{0, 4, 7, 5, 2, 6, 1, 3});
+
+    // Out of reach of input ordering in reasonable time
+    NQueens problem_4(60);
+    problem_4.variable_ordering = CSP_VariableOrdering::mrv_degree;
+    auto solution = problem_4.backtrack_fc<NQueensConstraint>();
+    REQUIRE(solution.size() == 60);
+    CHECK(is_n_queens_solution(solution));
+
+    // Constraints used in both directions: the last variable is picked first
+    LessThanChain problem_5(6, 6);
+    problem_5.variables[5]->domain = CSP_Domain(6);
+    problem_5.variables[5]->domain.insert(5);
+    problem_5.variable_ordering = CSP_VariableOrdering::mrv;
+    CHECK(problem_5.backtrack_fc() == std::vector<int>{0, 1, 2, 3, 4, 5});
+    problem_5.value_ordering = CSP_ValueOrdering::lcv;
+    CHECK(problem_5.backtrack() == std::vector<int>{0, 1, 2, 3, 4, 5});
+}
+
+TEST_CASE("CSP struct: dom/wdeg ordering on sparse graph coloring", "[CSP]") {
+    // Large enough for wipeouts to bump weights and reorder the heap of unassigned variables
+    GraphColoring problem_1(4000, 9000, 4, 1);
+    problem_1.variable_ordering = CSP_VariableOrdering::dom_wdeg;
+    CHECK(problem_1.is_solution(problem_1.backtrack_fc()));
+    CHECK(std::accumulate(problem_1.weights.begin(), problem_1.weights.end(), 0) > 9000);
+    CHECK(problem_1.is_solution(problem_1.backtrack_mac()));
+
+    // Every solution is still visited once
+    GraphColoring problem_2(12, 18, 3, 2);
+    long long n_solutions = problem_2.count_solutions();
+    CHECK(n_solutions > 0);
+    problem_2.variable_ordering = CSP_VariableOrdering::dom_wdeg;
+    CHECK(problem_2.count_solutions(CSP_Inference::forward_checking) == n_solutions);
+    CHECK(problem_2.count_solutions(CSP_Inference::mac) == n_solutions);
+}
+
+TEST_CASE("CSP struct: backtrack_cbj() function test", "[CSP]") {
+    // Backjumping only skips dead ends: with input ordering, the first solution is the one backtrack() finds
+    for (int nogood_capacity : {0, 4, 1000}) {
+        for (int n_queens : {1, 4, 8, 12}) {
+            NQueens problem_1(n_queens);
+            problem_1.nogood_capacity = nogood_capacity;
+            auto solution = problem_1.backtrack_cbj<NQueensConstraint>();
+            CHECK(solution == problem_1.backtrack<NQueensConstraint>());
+            CHECK(problem_1.nogoods.size() <= nogood_capacity);
+            if (n_queens == 12 && nogood_capacity > 0) {
+                CHECK(problem_1.nogoods.size() > 0);
+            }
+        }
+
+        NQueens problem_2(3);
+        problem_2.nogood_capacity = nogood_capacity;
+        CHECK(problem_2.backtrack_cbj().empty());
+
+        NQueens problem_3(10);
+        problem_3.nogood_capacity = nogood_capacity;
+        problem_3.variable_ordering = CSP_VariableOrdering::dom_wdeg;
+        problem_3.value_ordering = CSP_ValueOrdering::lcv;
+        auto solution = problem_3.backtrack_cbj<NQueensConstraint>();
+        REQUIRE(solution.size() == 10);
+        CHECK(is_n_queens_solution(solution));
+    }
+
+    // x_0 < x_13 with x_13 in {0}, and 12 unconstrained variables in between. Backtracking would try the 10^12
+    // assignments of the middle variables for each value of x_0, the dead end at x_13 jumps straight back to x_0.
+    LessThanChain problem_4(2, 10);
+    for (int i = 0; i < 12; i++) {
+        problem_4.variables.insert(problem_4.variables.begin() + 1, std::make_unique<CSP_Variable>());
+        problem_4.variables[1]->domain = CSP_Domain(10, true);
+    }
+    problem_4.variables[13]->domain = CSP_Domain(1, true);
+    CHECK(problem_4.backtrack_cbj().empty());
+
+    problem_4.variables[13]->domain = CSP_Domain(6);
+    problem_4.variables[13]->domain.insert(5);
+    auto solution = problem_4.backtrack_cbj();
+    REQUIRE(solution.size() == 14);
+    CHECK(solution[0] == 0);
+    CHECK(solution[13] == 5);
+}
+
+TEST_CASE("csp_search_parallel() function test", "[CSP]") {
+    auto inferences = {CSP_Inference::none, CSP_Inference::forward_checking, CSP_Inference::mac};
+    for (auto inference : inferences) {
+        for (int n_threads : {1, 4}) {
+            for (int n_queens : {1, 4, 8, 16}) {
+                NQueens problem_1(n_queens);
+                auto solution = csp_search_parallel<NQueensConstraint>(problem_1, inference, n_threads);
+                REQUIRE(solution.size() == n_queens);
+                CHECK(is_n_queens_solution(solution));
+            }
+
+            NQueens problem_2(3);
+            CHECK(csp_search_parallel(problem_2, inference, n_threads).empty());
+
+            // Unsatisfiable with a large tree: every subtree handed over is searched to the end
+            LessThanChain problem_3(9, 8);
+            CHECK(csp_search_parallel(problem_3, inference, n_threads).empty());
+
+            if (inference != CSP_Inference::none) {
+                NQueens problem_4(40);
+                problem_4.variable_ordering = CSP_VariableOrdering::mrv_degree;
+                problem_4.value_ordering = CSP_ValueOrdering::lcv;
+                auto solution = csp_search_parallel<NQueensConstraint>(problem_4, inference, n_threads);
+                REQUIRE(solution.size() == 40);
+                CHECK(is_n_queens_solution(solution));
+            }
+        }
+    }
+
+    // The problem is left as it was, sequential search still works
+    NQueens problem_5(8);
+    csp_search_parallel(problem_5);
+    CHECK(problem_5.backtrack_fc() == std::vector<int>{0, 4, 7, 5, 2, 6, 1, 3});
+}
+
+TEST_CASE("CSP struct: enumerate_solutions() and count_solutions()", "[CSP]") {
+    // Number of solutions of N-Queens for N = 1 to 9
+    std::vector<long long> n_solutions = {1, 0, 0, 2, 10, 4, 40, 92, 352};
+    auto inferences = {CSP_Inference::none, CSP_Inference::forward_checking, CSP_Inference::mac};
+    for (auto inference : inferences) {
+        for (int n_queens = 1; n_queens <= 9; n_queens++) {
+            NQueens problem_1(n_queens);
+            CHECK(problem_1.count_solutions<NQueensConstraint>(inference) == n_solutions[n_queens-1]);
+
+            // Reflection of the rows, each orbit has 2 solutions (a queen can not be on the middle row of every column)
+            std::vector<int> reflection(n_queens);
+            for (int x = 0; x < n_queens; x++) {
+                reflection[x] = n_queens - 1 - x;
+            }
+            problem_1.value_symmetries = {reflection};
+            long long n_visited = 0;
+            auto n_counted = problem_1.enumerate_solutions<NQueensConstraint>(inference, [&](CSP_Assignment solution, int orbit_size) {
+                std::vector<int> rows(solution.values, solution.values + solution.size);
+                CHECK(is_n_queens_solution(rows));
+                CHECK(orbit_size == (n_queens == 1 ? 1 : 2));
+                n_visited++;
+                return true;
+            });
+            CHECK(n_counted == n_solutions[n_queens-1]);
+            CHECK(n_visited == (n_queens == 1 ? 1 : n_solutions[n_queens-1] / 2));
+        }
+    }
+
+    // Every solution is visited once, in lexicographic order with input orderings
+    NQueens problem_2(6);
+    std::vector<std::vector<int>> solutions;
+    problem_2.enumerate_solutions(CSP_Inference::forward_checking, [&](CSP_Assignment solution, int) {
+        solutions.push_back(std::vector<int>(solution.values, solution.values + solution.size));
+        return true;
+    });
+    CHECK(solutions == std::vector<std::vector<int>>{{1, 3, 5, 0, 2, 4}, {2, 5, 1, 4, 0, 3}, {3, 0, 4, 1, 5, 2}, {4, 2, 0, 5, 3, 1}});
+
+    // Stops when the callback returns false
+    NQueens problem_3(8);
+    int n_calls = 0;
+    CHECK(problem_3.enumerate_solutions(CSP_Inference::forward_checking, [&](CSP_Assignment, int) { return ++n_calls < 5; }) == 5);
+    CHECK(problem_3.backtrack_fc() == std::vector<int>{0, 4, 7, 5, 2, 6, 1, 3});
+
+    // Orderings other than input still count every solution
+    problem_3.variable_ordering = CSP_VariableOrdering::dom_wdeg;
+    problem_3.value_ordering = CSP_ValueOrdering::lcv;
+    CHECK(problem_3.count_solutions<NQueensConstraint>() == 92);
+    CHECK(problem_3.count_solutions<NQueensConstraint>(CSP_Inference::mac) == 92);
+
+    LessThanChain problem_4(4, 6);
+    CHECK(problem_4.count_solutions() == 15);
+}
+
+TEST_CASE("CSP struct: global constraints", "[CSP]") {
+    std::vector<long long> n_solutions = {1, 0, 0, 2, 10, 4, 40, 92, 352};
+    auto inferences = {CSP_Inference::none, CSP_Inference::forward_checking, CSP_Inference::mac};
+    for (auto inference : inferences) {
+        for (int n_queens = 1; n_queens <= 9; n_queens++) {
+            NQueensGlobal problem_1(n_queens);
+            CHECK(problem_1.count_solutions(inference) == n_solutions[n_queens-1]);
+        }
+        NQueensGlobal problem_2(30);
+        problem_2.variable_ordering = CSP_VariableOrdering::mrv;
+        auto solution = problem_2.search(inference == CSP_Inference::none ? CSP_Inference::forward_checking : inference);
+        REQUIRE(solution.size() == 30);
+        CHECK(is_n_queens_solution(solution));
+    }
+
+    // Pigeonhole: no matching of 5 variables into 4 values, found before any search
+    CSP problem_3;
+    std::vector<CSP_Variable*> scope;
+    for (int i = 0; i < 5; i++) {
+        problem_3.variables.push_back(std::make_unique<CSP_Variable>());
+        problem_3.variables[i]->domain = CSP_Domain(4, true);
+        scope.push_back(problem_3.variables[i].get());
+    }
+    problem_3.global_constraints.push_back(std::make_unique<CSP_AllDifferent>(scope));
+    CHECK(!problem_3.arc_consistency());
+
+    // Hall set {x_0, x_1} on {0, 1}: x_2 and x_3 lose both values
+    CSP problem_4;
+    scope.clear();
+    for (int i = 0; i < 4; i++) {
+        problem_4.variables.push_back(std::make_unique<CSP_Variable>());
+        problem_4.variables[i]->domain = CSP_Domain(i < 2 ? 2 : 4, true);
+        scope.push_back(problem_4.variables[i].get());
+    }
+    problem_4.global_constraints.push_back(std::make_unique<CSP_AllDifferent>(scope));
+    CHECK(problem_4.arc_consistency());
+    CHECK(problem_4.variables[0]->domain.size() == 2);
+    CHECK(problem_4.variables[2]->domain.first() == 2);
+    CHECK(problem_4.variables[3]->domain.size() == 2);
+    CHECK(problem_4.count_solutions(CSP_Inference::mac) == 4);
+
+    // x_0 + 2 x_1 - x_2 = 3, every domain [0, 4)
+    for (auto relation : {CSP_Relation::less_equal, CSP_Relation::equal, CSP_Relation::greater_equal}) {
+        CSP problem_5;
+        scope.clear();
+        for (int i = 0; i < 3; i++) {
+            problem_5.variables.push_back(std::make_unique<CSP_Variable>());
+            problem_5.variables[i]->domain = CSP_Domain(4, true);
+            scope.push_back(problem_5.variables[i].get());
+        }
+        problem_5.global_constraints.push_back(std::make_unique<CSP_Linear>(scope, std::vector<int>{1, 2, -1}, relation, 3));
+        long long expected = 0;
+        for (int x = 0; x < 4; x++) {
+            for (int y = 0; y < 4; y++) {
+                for (int z = 0; z < 4; z++) {
+                    long long sum = x + 2*y - z;
+                    expected += relation == CSP_Relation::less_equal ? sum <= 3 : relation == CSP_Relation::equal ? sum == 3 : sum >= 3;
+                }
+            }
+        }
+        for (auto inference : inferences) {
+            CHECK(problem_5.count_solutions(inference) == expected);
+        }
+    }
+
+    // 2 x_0 + 3 x_1 <= 5 bounds x_0 to [0, 2] and x_1 to [0, 1]
+    CSP problem_6;
+    scope.clear();
+    for (int i = 0; i < 2; i++) {
+        problem_6.variables.push_back(std::make_unique<CSP_Variable>());
+        problem_6.variables[i]->domain = CSP_Domain(10, true);
+        scope.push_back(problem_6.variables[i].get());
+    }
+    problem_6.global_constraints.push_back(std::make_unique<CSP_Linear>(scope, std::vector<int>{2, 3}, CSP_Relation::less_equal, 5));
+    CHECK(problem_6.arc_consistency());
+    CHECK(problem_6.variables[0]->domain.last() == 2);
+    CHECK(problem_6.variables[1]->domain.last() == 1);
+
+    // Table over 3 variables, x_0 restricted to {1, 2}: only the tuples with x_0 in {1, 2} are left
+    std::vector<std::vector<int>> tuples = {{0, 1, 2}, {1, 0, 2}, {1, 2, 0}, {2, 2, 2}, {2, 0, 1}, {0, 0, 0}};
+    CSP problem_7;
+    scope.clear();
+    for (int i = 0; i < 3; i++) {
+        problem_7.variables.push_back(std::make_unique<CSP_Variable>());
+        problem_7.variables[i]->domain = CSP_Domain(3, true);
+        scope.push_back(problem_7.variables[i].get());
+    }
+    problem_7.variables[0]->domain.erase(0);
+    problem_7.global_constraints.push_back(std::make_unique<CSP_Table>(scope, tuples));
+    for (auto inference : inferences) {
+        std::vector<std::vector<int>> found;
+        problem_7.enumerate_solutions(inference, [&](CSP_Assignment solution, int) {
+            found.push_back(std::vector<int>(solution.values, solution.values + solution.size));
+            return true;
+        });
+        CHECK(found == std::vector<std::vector<int>>{{1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 2, 2}});
+    }
+    // Combined with binary constraints: x_1 < x_2 leaves (1, 0, 2) and (2, 0, 1)
+    problem_7.constraints.push_back(std::make_unique<LessThanConstraint>(*problem_7.variables[1], *problem_7.variables[2]));
+    for (auto inference : inferences) {
+        CHECK(problem_7.count_solutions(inference) == 2);
+    }
+    CHECK(problem_7.arc_consistency());
+    CHECK(problem_7.variables[1]->domain.size() == 1);
+
+    // Parallel workers share the constraints, their reversible state is per worker
+    NQueensGlobal problem_8(20);
+    auto solution = csp_search_parallel(problem_8, CSP_Inference::mac, 4);
+    REQUIRE(solution.size() == 20);
+    CHECK(is_n_queens_solution(solution));
+
+    // Table without tuples: nothing satisfies it
+    CSP problem_9;
+    scope.clear();
+    for (int i = 0; i < 2; i++) {
+        problem_9.variables.push_back(std::make_unique<CSP_Variable>());
+        problem_9.variables[i]->domain = CSP_Domain(3, true);
+        scope.push_back(problem_9.variables[i].get());
+    }
+    problem_9.global_constraints.push_back(std::make_unique<CSP_Table>(scope, std::vector<std::vector<int>>{}));
+    for (auto inference : inferences) {
+        CHECK(problem_9.count_solutions(inference) == 0);
+    }
+    CHECK(problem_9.backtrack().empty());
+    CHECK(problem_9.backtrack_mac().empty());
+    CHECK(!problem_9.arc_consistency());
+}
+
+TEST_CASE("CSP struct: finalize() function test", "[CSP]") {
+    // x_0 < x_1 < x_2
+    LessThanChain problem_1(3, 5);
+    problem_1.finalize();
+    CHECK(problem_1.finalized());
+    auto& graph = problem_1.graph;
+    CHECK(graph.arc_offsets == std::vector<int>{0, 1, 3, 4});
+    CHECK(graph.to_offsets == std::vector<int>{1, 2, 3});
+    REQUIRE(graph.arcs.size() == 4);
+    CHECK(graph.arcs[0].idx == 0);
+    CHECK(graph.arcs[0].other == 1);
+    CHECK(graph.arcs[1].idx == 1);
+    CHECK(graph.arcs[1].other == 2);
+    CHECK(graph.arcs[2].idx == 0);
+    CHECK(graph.arcs[2].other == 0);
+    CHECK(graph.arcs[3].constraint == problem_1.constraints[1].get());
+    CHECK(graph.scope == std::vector<int>{0, 1, 1, 2});
+    CHECK(graph.scope_offsets == std::vector<int>{0, 2, 4});
+    CHECK(graph.output_offsets == std::vector<int>{1, 3});
+    CHECK(graph.binary_input == std::vector<int>{0, 1});
+    CHECK(graph.binary_output == std::vector<int>{1, 2});
+    CHECK(graph.global_offsets == std::vector<int>{0, 0, 0, 0});
+
+    // Global constraints are listed per variable
+    NQueensGlobal problem_2(4);
+    problem_2.finalize();
+    CHECK(problem_2.graph.arcs.empty());
+    CHECK(problem_2.graph.global_offsets == std::vector<int>{0, 3, 6, 9, 12});
+    CHECK(problem_2.graph.globals == std::vector<int>{0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2});
+
+    // Adding a constraint to a solved model finalizes it again at the next search
+    LessThanChain problem_3(3, 3);
+    CHECK(problem_3.backtrack_fc() == std::vector<int>{0, 1, 2});
+    problem_3.constraints.push_back(std::make_unique<LessThanConstraint>(*problem_3.variables[2], *problem_3.variables[0]));
+    CHECK(!problem_3.finalized());
+    CHECK(problem_3.backtrack_fc().empty());
+}
+
+TEST_CASE("CSP struct: constraints with several inputs", "[CSP]") {
+    // x_0 + x_1 = x_2 with x_0 < x_1 and x_2 = 5: (0, 5), (1, 4), (2, 3)
+    LessThanChain problem(2, 6);
+    problem.variables.push_back(std::make_unique<CSP_Variable>());
+    problem.variables[2]->domain = CSP_Domain(6);
+    problem.variables[2]->domain.insert(5);
+    problem.constraints.push_back(std::make_unique<SumConstraint>(*problem.variables[0], *problem.variables[1], *problem.variables[2]));
+
+    // The output is only pruned once both inputs are assigned, whatever the variable ordering
+    for (auto ordering : {CSP_VariableOrdering::input, CSP_VariableOrdering::mrv, CSP_VariableOrdering::dom_wdeg}) {
+        problem.variable_ordering = ordering;
+        CHECK(problem.backtrack_fc() == std::vector<int>{0, 5, 5});
+        CHECK(problem.backtrack_mac() == std::vector<int>{0, 5, 5});
+        CHECK(problem.count_solutions(CSP_Inference::forward_checking) == 3);
+        CHECK(problem.count_solutions(CSP_Inference::mac) == 3);
+    }
+}
+
+TEST_CASE("csp_min_conflicts() function test", "[CSP]") {
+    CSP_LocalSearchSettings settings;
+    for (int n_threads : {1, 4}) {
+        settings.n_threads = n_threads;
+        for (int n_queens : {1, 4, 8, 50, 200}) {
+            NQueens problem_1(n_queens);
+            auto solution = csp_min_conflicts<NQueensConstraint>(problem_1, settings);
+            REQUIRE(solution.size() == n_queens);
+            CHECK(is_n_queens_solution(solution));
+        }
+    }
+
+    // A restart only depends on its seed
+    settings.n_threads = 1;
+    settings.n_restarts = 1;
+    settings.seed = 7;
+    NQueens problem_2(30);
+    auto solution = csp_min_conflicts<NQueensConstraint>(problem_2, settings);
+    CHECK(solution.size() == 30);
+    CHECK(csp_min_conflicts(problem_2, settings) == solution);
+
+    // No solution: every restart gives up after max_steps
+    settings.n_threads = 4;
+    settings.n_restarts = 4;
+    settings.max_steps = 1000;
+    NQueens problem_3(3);
+    CHECK(csp_min_conflicts(problem_3, settings).empty());
+
+    // Constraint with two inputs: x_0 + x_1 = x_2 with x_0 < x_1 and x_2 = 5
+    LessThanChain problem_4(2, 6);
+    problem_4.variables.push_back(std::make_unique<CSP_Variable>());
+    problem_4.variables[2]->domain = CSP_Domain(6);
+    problem_4.variables[2]->domain.insert(5);
+    problem_4.constraints.push_back(std::make_unique<SumConstraint>(*problem_4.variables[0], *problem_4.variables[1], *problem_4.variables[2]));
+    CHECK(problem_4.count_solutions() == 3);
+    settings.max_steps = 100000;
+    solution = csp_min_conflicts(problem_4, settings);
+    REQUIRE(solution.size() == 3);
+    CHECK(solution[0] < solution[1]);
+    CHECK(solution[0] + solution[1] == 5);
+
+    // Global constraints are not supported
+    NQueensGlobal problem_5(8);
+    CHECK(csp_min_conflicts(problem_5, settings).empty());
+}
+
+TEST_CASE("SearchControl struct: CSP search control test", "[CSP]") {
+    NQueens problem(10);
+    SearchControl control;
+
+    // No limit: same solution as without a control
+    auto expected = problem.backtrack_fc();
+    CHECK(problem.backtrack_fc(&control) == expected);
+    CHECK(control.status == SearchStatus::finished);
+    CHECK(control.n_nodes > 10);
+    CHECK(control.best_bound == 9);
+    CHECK(problem.count_solutions(CSP_Inference::forward_checking, &control) == 724);
+    CHECK(control.status == SearchStatus::finished);
+
+    control.node_budget = 5;
+    CHECK(problem.backtrack_fc(&control).empty());
+    CHECK(control.status == SearchStatus::out_of_nodes);
+    CHECK(control.n_nodes == 6);
+    CHECK(problem.backtrack_cbj(&control).empty());
+    CHECK(control.status == SearchStatus::out_of_nodes);
+    long long n_counted = problem.count_solutions(CSP_Inference::forward_checking, &control);
+    CHECK(n_counted == 0);
+    control.node_budget = -1;
+
+    // The search stays usable after being stopped
+    CHECK(problem.backtrack_fc() == expected);
+
+    // Deadline already passed, checked at the first node
+    control.set_time_budget(-1);
+    CHECK(problem.backtrack_mac(&control).empty());
+    CHECK(control.status == SearchStatus::timed_out);
+    CHECK(control.n_nodes == 1);
+    control.deadline = std::chrono::steady_clock::time_point::max();
+
+    // Intervals that are not a positive power of two still read the clock: 0 and negative ones on every node
+    NQueens hard(12);
+    for (int check_interval : {0, -4, 3}) {
+        control.check_interval = check_interval;
+        control.set_time_budget(1e-3);
+        CHECK(hard.count_solutions(CSP_Inference::forward_checking, &control) < 14200);
+        CHECK(control.status == SearchStatus::timed_out);
+    }
+    control.deadline = std::chrono::steady_clock::time_point::max();
+
+    // The progress callback sees the counters and can stop the search
+    std::vector<SearchProgress> reports;
+    control.check_interval = 1;
+    control.progress_interval = 0;
+    control.on_progress = [&](const SearchProgress& progress) {
+        reports.push_back(progress);
+        return reports.size() < 50;
+    };
+    CHECK(hard.count_solutions(CSP_Inference::forward_checking, &control) < 14200);
+    CHECK(control.status == SearchStatus::cancelled);
+    REQUIRE(reports.size() == 50);
+    CHECK(reports.back().n_nodes == 50);
+    CHECK(reports.back().best_bound >= reports.front().best_bound);
+    control.on_progress = nullptr;
+
+    // Cancelled from another thread before the search: it stops at the first node
+    std::thread([&]() { control.cancel(); }).join();
+    CHECK(hard.backtrack(&control).empty());
+    CHECK(control.status == SearchStatus::cancelled);
+    control.reset_cancel();
+    CHECK(!hard.backtrack(&control).empty());
+    CHECK(control.status == SearchStatus::finished);
+}
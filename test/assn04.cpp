@@ -7,10 +7,9 @@
 #include <vector>
 
 struct NQueensDomain : CSP_Domain {
-    NQueensDomain(int n_queens) {
-        domain.resize(n_queens);
-        for (int i = 0; i < domain.size(); i++) {
-            domain[i] = i;
+    NQueensDomain(int n_queens) : CSP_Domain(n_queens) {
+        for (int i = 0; i < n_queens; i++) {
+            insert(i);
         }
     }
 };
@@ -48,7 +47,7 @@ struct NQueensConstraint : CSP_Constraint {
         return true;
     }
 
-    bool consistent(std::vector<int> a, int x) override {
+    bool consistent(CSP_Assignment a, int x) override {
         auto* var1 = static_cast<NQueensVariable*>(input_var[0]);
         auto* var2 = static_cast<NQueensVariable*>(output_var[0]);
 
@@ -122,7 +121,7 @@ int main() {
     // }
     
     // auto T1 = blast::get_tick_us();
-    // auto solution = problem_1.backtrack();
+    // auto solution = problem_1.backtrack<NQueensConstraint>();
     // auto T2 = blast::get_tick_us();
 
     // print(solution);
@@ -141,7 +140,7 @@ int main() {
         }
     }
     auto T1 = blast::get_tick_us();
-    auto solution = problem_2.backtrack_fc();
+    auto solution = problem_2.backtrack_fc<NQueensConstraint>();
     auto T2 = blast::get_tick_us();
 
     print(solution);
@@ -0,0 +1,72 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+
+#include "catch2/catch.hpp"
+#include "blast_rush.h"
+#include "../extern/blast_rush/tests/test_helper/test_helper.hpp"
+#include "../extern/blast_rush/tests/test_helper/test_functions.hpp"
+#include "../utilities.hpp"
+#include "../task.hpp"
+
+TEST_CASE("motion time kernels throughput", "[Task]") {
+    auto manip = get_generic_Link6();
+
+    // One joint, every displacement in [-pi, pi]
+    int n = 4096;
+    std::vector<real> displacements(n);
+    std::vector<real> times(n);
+    for (int k = 0; k < n; k++) {
+        displacements[k] = (2.0*k/(n - 1) - 1)*3.14159265358979;
+    }
+    real jmax = 10*manip.amax[0];
+
+    BENCHMARK("trapezoidal_velocity_profile_time() x4096") {
+        for (int k = 0; k < n; k++) {
+            times[k] = trapezoidal_velocity_profile_time(displacements[k], manip.vmax[0], manip.vmin[0], manip.amax[0], manip.amin[0]);
+        }
+        return times[n - 1];
+    };
+
+    BENCHMARK("s_curve_velocity_profile_time() scalar x4096") {
+        for (int k = 0; k < n; k++) {
+            times[k] = s_curve_velocity_profile_time(displacements[k], manip.vmax[0], manip.vmin[0], manip.amax[0], manip.amin[0], jmax);
+        }
+        return times[n - 1];
+    };
+
+    BENCHMARK("s_curve_velocity_profile_time() batched x4096") {
+        s_curve_velocity_profile_time(displacements.data(), n, manip.vmax[0], manip.vmin[0], manip.amax[0], manip.amin[0], jmax, times.data());
+        return times[n - 1];
+    };
+}
+
+TEST_CASE("setup() with each cost model", "[Task]") {
+    auto manip = get_generic_Link6();
+    World world;
+    auto demo1_tasks = get_Link6_demo1_tasks_simple();
+
+    TaskSequencingProblem example_task(manip);
+
+    // Enough tasks for the cost matrix to dominate
+    for (int k = 0; k < 50; k++) {
+        for (int i = 0; i < demo1_tasks.size(); i++) {
+            example_task.add_task(Task(demo1_tasks[i]));
+        }
+    }
+    example_task.start_position = get_Link6_home();
+
+    BENCHMARK("setup() trapezoidal") {
+        example_task.cost_model = nullptr;
+        example_task.setup(world);
+    };
+
+    BENCHMARK("setup() TrapezoidalCostModel") {
+        example_task.cost_model = std::make_shared<TrapezoidalCostModel>();
+        example_task.setup(world);
+    };
+
+    BENCHMARK("setup() SCurveCostModel") {
+        example_task.cost_model = std::make_shared<SCurveCostModel>(Array(manip.joints, 10.0));
+        example_task.setup(world);
+    };
+}
@@ -0,0 +1,508 @@
+#define CATCH_CONFIG_MAIN
+#include "catch2/catch.hpp"
+#include "blast_rush.h"
+#include "../graphs.hpp"
+#include "../graphs_parallel.hpp"
+#include "../graphs_implicit.hpp"
+#include <cstdio>
+
+using namespace blast;
+
+// Costs between the example states of State::get_reachable_states()
+Matrix get_example_costs() {
+    Matrix costs(7, 7);
+    costs(1, 2) = 1;
+    costs(1, 3) = 2;
+    costs(2, 4) = 3;
+    costs(3, 4) = 4;
+    costs(3, 5) = 5;
+    costs(5, 1) = 6;
+    costs(6, 1) = 7;
+    return costs;
+}
+
+std::vector<int> get_indices(const std::vector<State>& path) {
+    std::vector<int> result;
+    for (const auto& state : path) {
+        result.push_back(state.idx);
+    }
+    return result;
+}
+
+TEST_CASE("RingBuffer struct function test", "[Graph]") {
+    RingBuffer<int> buffer;
+    CHECK(buffer.empty());
+    for (int i = 0; i < 16; i++) {
+        buffer.push_back(i);
+    }
+    for (int i = 0; i < 5; i++) {
+        CHECK(buffer.pop_front() == i);
+    }
+    // Wraps around the end of the buffer, then grows while head != 0
+    for (int i = 16; i < 21; i++) {
+        buffer.push_back(i);
+    }
+    REQUIRE(buffer.head == 5);
+    REQUIRE(buffer.size() == buffer.items.size());
+    buffer.push_back(21);
+    CHECK(buffer.items.size() == 32);
+    CHECK(buffer.size() == 17);
+    CHECK(buffer.front() == 5);
+    CHECK(buffer.back() == 21);
+
+    CHECK(buffer.pop_back() == 21);
+    CHECK(buffer.pop_front() == 5);
+    CHECK(buffer.pop_back() == 20);
+    for (int i = 22; i < 40; i++) {
+        buffer.push_back(i);
+    }
+    std::vector<int> items;
+    while (buffer.size() > 2) {
+        items.push_back(buffer.pop_front());
+        items.push_back(buffer.pop_back());
+    }
+    CHECK(items.front() == 6);
+    CHECK(items[1] == 39);
+    CHECK(buffer.pop_front() == 23);
+    CHECK(buffer.pop_back() == 24);
+    CHECK(buffer.empty());
+
+    buffer.push_back(1);
+    buffer.clear();
+    CHECK(buffer.empty());
+}
+
+TEST_CASE("UninformedSearch struct: search() function test", "[Graph]") {
+    UninformedSearch search;
+    search.costs = get_example_costs();
+
+    // Expands 2 first, backtracks from the dead end 4, then goes through 3
+    search.search_type = uninformed_search_type::DEPTH_FIRST;
+    CHECK(get_indices(search.search(State{1}, State{5})) == std::vector<int>{1, 3, 5});
+    CHECK(search.nodes.size() == 5);
+    CHECK(search.search_queue.empty());
+    CHECK(search.nodes.back().path_cost == 7);
+    CHECK(get_indices(search.search(State{1}, State{4})) == std::vector<int>{1, 2, 4});
+    CHECK(get_indices(search.search(State{3}, State{2})) == std::vector<int>{3, 5, 1, 2});
+    CHECK(get_indices(search.search(State{1}, State{1})) == std::vector<int>{1});
+
+    search.search_type = uninformed_search_type::BREADTH_FIRST;
+    CHECK(get_indices(search.search(State{1}, State{5})) == std::vector<int>{1, 3, 5});
+    CHECK(get_indices(search.search(State{1}, State{4})) == std::vector<int>{1, 2, 4});
+    CHECK(search.nodes.size() == 4);
+    CHECK(search.nodes.back().path_cost == 4);
+    CHECK(get_indices(search.search(State{6}, State{4})) == std::vector<int>{6, 1, 2, 4});
+
+    // Unreachable goals: the queue runs empty
+    for (auto type : {uninformed_search_type::DEPTH_FIRST, uninformed_search_type::BREADTH_FIRST}) {
+        search.search_type = type;
+        CHECK(search.search(State{1}, State{6}).empty());
+        CHECK(search.nodes.size() == 5);
+        CHECK(search.search_queue.empty());
+        CHECK(search.search(State{4}, State{1}).empty());
+        CHECK(search.nodes.size() == 1);
+    }
+
+    // Without the visited list states are generated again, and breadth first search still finds the shortest path
+    search.use_visited_list = false;
+    CHECK(get_indices(search.search(State{5}, State{4})) == std::vector<int>{5, 1, 2, 4});
+    CHECK(search.nodes.size() == 5);
+}
+
+// 0 - 1 - 2 - 3 in a line, with a shortcut 0 - 3 and an isolated vertex 4
+std::vector<Edge> get_line_edges() {
+    return {{0, 1, 1}, {1, 2, 2}, {2, 3, 3}, {0, 3, 10}};
+}
+
+TEST_CASE("graph_from_edges() function test", "[Graph]") {
+    auto graph = graph_from_edges(5, get_line_edges());
+    REQUIRE(graph.n_vertices() == 5);
+    REQUIRE(graph.n_edges() == 4);
+    CHECK(graph.degree(0) == 2);
+    CHECK(graph.degree(3) == 0);
+    CHECK(graph.degree(4) == 0);
+    // Edges of a vertex keep their order in the list
+    CHECK(graph.targets[graph.offsets[0]] == 1);
+    CHECK(graph.targets[graph.offsets[0] + 1] == 3);
+    CHECK(graph.weights[graph.offsets[0] + 1] == 10);
+
+    auto undirected = graph_from_edges(5, get_line_edges(), true);
+    CHECK(undirected.n_edges() == 8);
+    CHECK(undirected.degree(3) == 2);
+    CHECK(undirected.targets[undirected.offsets[1]] == 0);
+    CHECK(undirected.weights[undirected.offsets[1]] == 1);
+
+    // Edges with a vertex out of range are skipped
+    auto skipped = graph_from_edges(2, {{0, 1}, {1, 5}, {-1, 0}});
+    CHECK(skipped.n_edges() == 1);
+}
+
+TEST_CASE("load_edge_list() function test", "[Graph]") {
+    std::string path = "graphs_test_edges.txt";
+    {
+        std::ofstream file(path);
+        file << "# from to weight\n0 1 1.5\n1 2\n\n2 0 4\n";
+    }
+    Graph graph;
+    REQUIRE(load_edge_list(path, graph));
+    CHECK(graph.n_vertices() == 3);
+    CHECK(graph.n_edges() == 3);
+    CHECK(graph.weights[graph.offsets[0]] == 1.5f);
+    CHECK(graph.weights[graph.offsets[1]] == 1);
+
+    {
+        std::ofstream file(path);
+        file << "0 1\nnot an edge\n";
+    }
+    CHECK_FALSE(load_edge_list(path, graph));
+    std::remove(path.c_str());
+    CHECK_FALSE(load_edge_list("missing_edges.txt", graph));
+}
+
+TEST_CASE("UninformedSearch struct: search() on a Graph function test", "[Graph]") {
+    auto graph = graph_from_edges(5, get_line_edges(), true);
+    UninformedSearch search;
+    search.graph = &graph;
+
+    search.search_type = uninformed_search_type::BREADTH_FIRST;
+    auto path = search.search(State{0}, State{3});
+    REQUIRE(path.size() == 2);
+    CHECK(path[0].idx == 0);
+    CHECK(path[1].idx == 3);
+    CHECK(search.nodes.size() <= 5);
+
+    search.search_type = uninformed_search_type::DEPTH_FIRST;
+    path = search.search(State{0}, State{2});
+    REQUIRE(path.size() == 3);
+    for (int i = 0; i < 3; i++) {
+        CHECK(path[i].idx == i);
+    }
+    CHECK(search.nodes.back().path_cost == 3);
+
+    CHECK(search.search(State{0}, State{4}).empty());
+    CHECK(search.search(State{2}, State{2}).size() == 1);
+}
+
+TEST_CASE("ShortestPathSearch struct: search() function test", "[Graph]") {
+    auto graph = graph_from_edges(5, get_line_edges(), true);
+    ShortestPathSearch search;
+    search.graph = &graph;
+    // Remaining cost along the line, a consistent heuristic towards 3
+    std::vector<float> to_end = {6, 5, 3, 0, 0};
+    search.heuristic = [&](int v) { return to_end[v]; };
+
+    for (auto type : {shortest_path_type::DIJKSTRA, shortest_path_type::A_STAR, shortest_path_type::RADIX_DIJKSTRA}) {
+        search.search_type = type;
+        // The shortcut 0 - 3 costs 10, the line 6
+        auto path = search.search(State{0}, State{3});
+        REQUIRE(path.size() == 4);
+        for (int i = 0; i < 4; i++) {
+            CHECK(path[i].idx == i);
+        }
+        CHECK(search.distance[3] == 6);
+        CHECK(search.parent[0] == -1);
+
+        CHECK(search.search(State{0}, State{4}).empty());
+        CHECK(search.search(State{2}, State{2}).size() == 1);
+    }
+
+    // The heuristic leads A* straight along the line
+    search.search_type = shortest_path_type::A_STAR;
+    search.search(State{0}, State{3});
+    CHECK(search.n_expanded == 3);
+
+    auto fractional = graph_from_edges(2, {{0, 1, 0.5}});
+    search.graph = &fractional;
+    search.search_type = shortest_path_type::RADIX_DIJKSTRA;
+    CHECK(search.search(State{0}, State{1}).empty());
+}
+
+TEST_CASE("ShortestPathSearch struct: modes agree on a random graph function test", "[Graph]") {
+    int n_vertices = 300;
+    std::vector<Edge> edges;
+    unsigned seed = 12345;
+    auto next = [&]() { seed = seed*1103515245 + 12345; return (seed >> 8) % 1000; };
+    for (int i = 0; i < 4*n_vertices; i++) {
+        edges.push_back({(int)(next() % n_vertices), (int)(next() % n_vertices), (float)(1 + next() % 50)});
+    }
+    auto graph = graph_from_edges(n_vertices, edges);
+
+    ShortestPathSearch dijkstra;
+    dijkstra.graph = &graph;
+    ShortestPathSearch radix;
+    radix.graph = &graph;
+    ShortestPathSearch a_star;
+    a_star.graph = &graph;
+    for (int end = 1; end < n_vertices; end += 7) {
+        // Weights are at least 1, so this is admissible but not consistent and vertices get reopened
+        auto heuristic = [&](int v) { return (v != end && v % 3 == 0) ? 1.f : 0.f; };
+        bool found = dijkstra.dijkstra(0, end);
+        CHECK(radix.radix_dijkstra(0, end) == found);
+        CHECK(a_star.a_star(0, end, heuristic) == found);
+        if (found) {
+            CHECK(radix.distance[end] == dijkstra.distance[end]);
+            CHECK(a_star.distance[end] == dijkstra.distance[end]);
+            // The path found adds up to its distance
+            auto path = radix.path(end);
+            float cost = 0;
+            for (int i = 0; i + 1 < path.size(); i++) {
+                float best = std::numeric_limits<float>::infinity();
+                for (int e = graph.offsets[path[i]]; e < graph.offsets[path[i] + 1]; e++) {
+                    if (graph.targets[e] == path[i + 1] && graph.weights[e] < best) {
+                        best = graph.weights[e];
+                    }
+                }
+                cost += best;
+            }
+            CHECK(cost == dijkstra.distance[end]);
+        }
+    }
+}
+
+TEST_CASE("RoadmapQueries struct: query() function test", "[Graph]") {
+    int n_vertices = 400;
+    std::vector<Edge> edges;
+    unsigned seed = 777;
+    auto next = [&]() { seed = seed*1103515245 + 12345; return (seed >> 8) % 1000; };
+    for (int i = 0; i < 3*n_vertices; i++) {
+        // Vertices 390 and up are left out, so that some queries have no path
+        edges.push_back({(int)(next() % 390), (int)(next() % 390), (float)(1 + next() % 20)});
+    }
+    auto graph = graph_from_edges(n_vertices, edges);
+
+    RoadmapQueries engine;
+    engine.preprocess(graph, 6);
+    REQUIRE(engine.landmarks.size() == 6);
+    CHECK(engine.landmarks[0] == 0);
+
+    ShortestPathSearch reference;
+    reference.graph = &graph;
+    // Vertices the first landmark does not reach are picked first
+    reference.dijkstra(0, -1);
+    CHECK(reference.distance[engine.landmarks[1]] == std::numeric_limits<float>::infinity());
+    QueryBuffers buffers;
+    int n_ends = 0;
+    for (int start = 0; start < n_vertices; start += 37) {
+        reference.dijkstra(start, -1);
+        for (int end = 3; end < n_vertices; end += 41) {
+            bool found = engine.query(start, end, buffers);
+            REQUIRE(found == (reference.distance[end] != std::numeric_limits<float>::infinity()));
+            CHECK(engine.heuristic(start, end) <= reference.distance[end]);
+            if (found) {
+                n_ends++;
+                CHECK(buffers.distance_of(end) == reference.distance[end]);
+                auto path = engine.path(end, buffers);
+                REQUIRE(!path.empty());
+                CHECK(path.front() == start);
+                CHECK(path.back() == end);
+            } else {
+                CHECK(engine.path(end, buffers).empty());
+            }
+        }
+    }
+    CHECK(n_ends > 0);
+
+    // Stamps of earlier queries must not be mistaken for current ones when the generation wraps around
+    buffers.generation = std::numeric_limits<uint32_t>::max();
+    REQUIRE(engine.query(0, 0, buffers));
+    CHECK(buffers.generation == 1);
+    CHECK(buffers.distance_of(5) == std::numeric_limits<float>::infinity());
+
+    CHECK_FALSE(engine.query(0, n_vertices, buffers));
+}
+
+// Breadth first search tree checked against a sequential search with unit weights
+void check_bfs_tree(const Graph& graph, const BFSTree& tree, int source) {
+    auto unit = graph;
+    std::fill(unit.weights.begin(), unit.weights.end(), 1.f);
+    ShortestPathSearch reference;
+    reference.graph = &unit;
+    reference.dijkstra(source, -1);
+    REQUIRE(tree.distance.size() == graph.n_vertices());
+    REQUIRE(tree.parent.size() == graph.n_vertices());
+    CHECK(tree.parent[source] == -1);
+    int n_errors = 0;
+    for (int v = 0; v < graph.n_vertices(); v++) {
+        if (reference.distance[v] == std::numeric_limits<float>::infinity()) {
+            n_errors += tree.distance[v] != -1 || tree.parent[v] != -1;
+            continue;
+        }
+        n_errors += tree.distance[v] != reference.distance[v];
+        if (v != source) {
+            int u = tree.parent[v];
+            bool has_edge = false;
+            for (int e = graph.offsets[u]; e < graph.offsets[u+1]; e++) {
+                has_edge = has_edge || graph.targets[e] == v;
+            }
+            n_errors += !has_edge || tree.distance[u] != tree.distance[v] - 1;
+        }
+    }
+    CHECK(n_errors == 0);
+}
+
+TEST_CASE("parallel_bfs() function test", "[Graph]") {
+    // Dense enough that the middle levels go bottom up
+    int n_vertices = 20000;
+    std::vector<Edge> edges;
+    unsigned seed = 4242;
+    auto next = [&]() { seed = seed*1103515245 + 12345; return (seed >> 8) % 1000000; };
+    for (int i = 0; i < 8*n_vertices; i++) {
+        // Vertices 19900 and up are left out, so that some are not reached
+        edges.push_back({(int)(next() % 19900), (int)(next() % 19900)});
+    }
+    auto directed = graph_from_edges(n_vertices, edges);
+    auto incoming = reversed(directed);
+    auto undirected = graph_from_edges(n_vertices, edges, true);
+
+    for (int n_threads : {1, 3}) {
+        check_bfs_tree(directed, parallel_bfs(directed, incoming, 7, n_threads), 7);
+        check_bfs_tree(undirected, parallel_bfs(undirected, 7, n_threads), 7);
+    }
+
+    // A long line stays top down
+    std::vector<Edge> line;
+    for (int v = 0; v + 1 < 1000; v++) {
+        line.push_back({v, v + 1});
+    }
+    auto line_graph = graph_from_edges(1000, line, true);
+    auto tree = parallel_bfs(line_graph, 500, 2);
+    check_bfs_tree(line_graph, tree, 500);
+    CHECK(tree.distance[0] == 500);
+
+    CHECK(parallel_bfs(line_graph, 1000).parent.empty());
+}
+
+struct GridState {
+    int x;
+    int y;
+};
+
+struct GridStateHash {
+    size_t operator()(const GridState& state) const {
+        return hash_combine(std::hash<int>()(state.x), std::hash<int>()(state.y));
+    }
+};
+
+struct GridStateEqual {
+    bool operator()(const GridState& state1, const GridState& state2) const {
+        return state1.x == state2.x && state1.y == state2.y;
+    }
+};
+
+TEST_CASE("StateTable struct: insert() and find() function test", "[Graph]") {
+    StateTable<std::vector<int>, VectorHash> table;
+    for (int i = 0; i < 1000; i++) {
+        auto added = table.insert({i % 10, i / 10});
+        CHECK(added.first == i);
+        CHECK(added.second);
+    }
+    CHECK(table.size() == 1000);
+    CHECK(table.insert({3, 5}).first == 53);
+    CHECK_FALSE(table.insert({3, 5}).second);
+    CHECK(table.find({9, 99}) == 999);
+    CHECK(table.find({10, 0}) == -1);
+    CHECK(table[999] == std::vector<int>{9, 99});
+    table.clear();
+    CHECK(table.find({3, 5}) == -1);
+}
+
+TEST_CASE("ImplicitSearch struct: search function test", "[Graph]") {
+    // Unbounded 4-connected grid with a wall at x = 5 for y from -10 to 10, moving up costs 2
+    auto successors = [](const GridState& state, auto emit) {
+        const int dx[4] = {1, -1, 0, 0};
+        const int dy[4] = {0, 0, 1, -1};
+        for (int k = 0; k < 4; k++) {
+            GridState next = {state.x + dx[k], state.y + dy[k]};
+            if (next.x == 5 && next.y >= -10 && next.y <= 10) {
+                continue;
+            }
+            emit(next, k == 2 ? 2.f : 1.f);
+        }
+    };
+    auto search = make_implicit_search<GridState>(successors, GridStateHash(), GridStateEqual());
+    GridState goal = {8, 0};
+    auto is_goal = [&](const GridState& state) { return state.x == goal.x && state.y == goal.y; };
+    auto manhattan = [&](const GridState& state) { return (float)(std::abs(state.x - goal.x) + std::abs(state.y - goal.y)); };
+
+    // Around the wall: 8 steps along x and 11 down then 11 up
+    int found = search.breadth_first(GridState{0, 0}, is_goal);
+    REQUIRE(found != -1);
+    auto path = search.path(found);
+    CHECK(path.size() == 31);
+    CHECK(path.front().x == 0);
+    CHECK(is_goal(path.back()));
+
+    found = search.dijkstra(GridState{0, 0}, is_goal);
+    REQUIRE(found != -1);
+    // Going up is dearer, the path goes down around the wall
+    CHECK(search.distance[found] == 8 + 11 + 2*11);
+    int dijkstra_expanded = search.n_expanded;
+
+    found = search.a_star(GridState{0, 0}, is_goal, manhattan);
+    REQUIRE(found != -1);
+    CHECK(search.distance[found] == 8 + 11 + 2*11);
+    CHECK(search.n_expanded < dijkstra_expanded);
+    for (int i = 0; i + 1 < search.path(found).size(); i++) {
+        auto step = search.path(found);
+        CHECK(std::abs(step[i].x - step[i+1].x) + std::abs(step[i].y - step[i+1].y) == 1);
+    }
+
+    // Never found on an unbounded grid, the search stops at max_states
+    search.max_states = 500;
+    CHECK(search.breadth_first(GridState{0, 0}, [](const GridState& state) { return state.x == 1000; }) == -1);
+    CHECK(search.table.size() <= 504);
+}
+
+TEST_CASE("UninformedSearch struct: DEPTH_LIMITED and ITERATIVE_DEEPENING function test", "[Graph]") {
+    int n_vertices = 60;
+    std::vector<Edge> edges;
+    unsigned seed = 99;
+    auto next = [&]() { seed = seed*1103515245 + 12345; return (seed >> 8) % 1000; };
+    for (int i = 0; i < 2*n_vertices; i++) {
+        edges.push_back({(int)(next() % n_vertices), (int)(next() % n_vertices)});
+    }
+    auto graph = graph_from_edges(n_vertices, edges);
+
+    UninformedSearch reference;
+    reference.graph = &graph;
+    reference.search_type = uninformed_search_type::BREADTH_FIRST;
+    UninformedSearch search;
+    search.graph = &graph;
+    search.depth_limit = 12;
+
+    int n_found = 0;
+    for (int table_size : {0, 7, 256}) {
+        search.transposition_table_size = table_size;
+        for (int end = 1; end < n_vertices; end++) {
+            auto shortest = reference.search(State{0}, State{end});
+
+            search.search_type = uninformed_search_type::ITERATIVE_DEEPENING;
+            auto path = search.search(State{0}, State{end});
+            REQUIRE(path.size() == shortest.size());
+            if (path.empty()) {
+                continue;
+            }
+            n_found++;
+            CHECK(path.front().idx == 0);
+            CHECK(path.back().idx == end);
+            for (int i = 0; i + 1 < path.size(); i++) {
+                bool has_edge = false;
+                for (int e = graph.offsets[path[i].idx]; e < graph.offsets[path[i].idx + 1]; e++) {
+                    has_edge = has_edge || graph.targets[e] == path[i+1].idx;
+                }
+                CHECK(has_edge);
+            }
+            // Memory is the current path only
+            CHECK(search.path.size() <= search.depth_limit + 1);
+
+            search.search_type = uninformed_search_type::DEPTH_LIMITED;
+            auto limited = search.search(State{0}, State{end});
+            CHECK(!limited.empty());
+            CHECK(limited.size() <= search.depth_limit + 1);
+            search.depth_limit = shortest.size() - 2;
+            CHECK(search.search(State{0}, State{end}).empty());
+            search.depth_limit = 12;
+        }
+    }
+    CHECK(n_found > 30);
+}
@@ -8,6 +8,9 @@
 #define private public
 #include "../task.hpp"
 #undef private
+#include "../problem_file.hpp"
+#include "../task_stream.hpp"
+#include <thread>
 
 using namespace blast;
 
@@ -281,3 +284,411 @@ TEST_CASE("Task struct: setup() function test", "[Task]") {
     CHECK(is_close(example_task.minimum_cost_to_reach, expected_minimum_cost_to_reach, 1e-4));
     CHECK(is_close(example_task.task_domain, expected_task_domain, 1e-4));
 }
+
+
+TEST_CASE("Problem file: save_task_sequencing_problem() and load_task_sequencing_problem() function test", "[Task]") {
+    auto manip = get_generic_Link6();
+    World world;
+    auto demo1_tasks = get_Link6_demo1_tasks_simple();
+    
+    TaskSequencingProblem example_task(manip);
+
+    for (int i = 0; i < demo1_tasks.size(); i++) {
+        example_task.add_task(Task(demo1_tasks[i]));
+    }
+
+    example_task.start_position = get_Link6_home();
+    example_task.add_order_constraint(0, 1);
+
+    Array domain(demo1_tasks.size());
+    domain[0] = 1.0;
+    domain[1] = 1.0;
+    example_task.add_domain_constraint(2, domain);
+
+    example_task.setup(world);
+
+    std::string path = "test_problem_file.bin";
+    REQUIRE(save_task_sequencing_problem(example_task, path));
+
+    // Read in place
+    MappedTaskSequencingProblem view;
+    REQUIRE(view.open(path));
+    CHECK(view.n_tasks() == example_task.working_set.size());
+    CHECK(view.n_joints() == manip.joints);
+    for (int i = 0; i < view.n_tasks(); i++) {
+        CHECK(view.task_id(i) == example_task.working_set[i].task_id);
+        CHECK(view.cost_from_start(i) == example_task.cost_from_start[i]);
+        CHECK(view.minimum_cost_to_reach(i) == example_task.minimum_cost_to_reach[i]);
+        for (int j = 0; j < view.n_tasks(); j++) {
+            CHECK(view.cost(i, j) == example_task.cost(i, j));
+            CHECK(view.task_domain(i, j) == example_task.task_domain(i, j));
+        }
+    }
+
+    // Load without setup()
+    TaskSequencingProblem loaded_task(manip);
+    REQUIRE(load_task_sequencing_problem(view, loaded_task));
+    CHECK(loaded_task.working_set.size() == example_task.working_set.size());
+    CHECK(is_close(loaded_task.working_set[3].end_position, example_task.working_set[3].end_position));
+    CHECK(is_close(loaded_task.start_position, example_task.start_position));
+    CHECK(is_close(loaded_task.cost, example_task.cost));
+    CHECK(is_close(loaded_task.task_domain, example_task.task_domain));
+    CHECK(loaded_task.order_constraints.size() == 1);
+    CHECK(loaded_task.order_constraints[0].later == 1);
+    CHECK(loaded_task.domain_constraints.size() == 1);
+    CHECK(is_close(loaded_task.domain_constraints[0].domain, domain));
+    CHECK(loaded_task.joint_space_tasks.size() == example_task.joint_space_tasks.size());
+
+    view.file.close();
+
+    // Rejects headers whose counts do not match the sections
+    std::string content;
+    {
+        std::ifstream file(path, std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    auto check_corrupted = [&](size_t offset, const void* value, size_t size) {
+        auto corrupted = content;
+        std::memcpy(&corrupted[offset], value, size);
+        std::ofstream file(path, std::ios::binary);
+        file.write(corrupted.data(), corrupted.size());
+        file.close();
+        CHECK(!view.open(path));
+        CHECK(view.header == nullptr);
+    };
+    std::cout << "Should give 5 errors: " << std::endl;
+    int32_t n_tasks = 1000;
+    check_corrupted(offsetof(ProblemFileHeader, n_tasks), &n_tasks, sizeof(n_tasks));
+    int32_t n_joints = -1;
+    check_corrupted(offsetof(ProblemFileHeader, n_joints), &n_joints, sizeof(n_joints));
+    int32_t n_order_constraints = 2;
+    check_corrupted(offsetof(ProblemFileHeader, n_order_constraints), &n_order_constraints, sizeof(n_order_constraints));
+    uint64_t cost_size = 8;
+    check_corrupted(offsetof(ProblemFileHeader, sizes) + (int)ProblemFileSection::cost*sizeof(uint64_t), &cost_size, sizeof(cost_size));
+    // The domain constraint claims more values than the header counts
+    ProblemFileHeader header;
+    std::memcpy(&header, content.data(), sizeof(header));
+    int32_t domain_size = 1000;
+    check_corrupted(header.offsets[(int)ProblemFileSection::domain_constraints] + sizeof(int32_t), &domain_size, sizeof(domain_size));
+    std::remove(path.c_str());
+
+    // Rejects a file which is not a problem file
+    std::ofstream garbage(path, std::ios::binary);
+    garbage << "not a problem file";
+    garbage.close();
+    std::cout << "Should give 1 error: " << std::endl;
+    CHECK(!view.open(path));
+    std::remove(path.c_str());
+}
+
+TEST_CASE("TaskStream struct: finish() matches setup() function test", "[Task]") {
+    auto manip = get_generic_Link6();
+    World world;
+    auto demo1_tasks = get_Link6_demo1_tasks_simple();
+    
+    TaskSequencingProblem example_task(manip);
+    TaskStream stream(manip, get_Link6_home(), 4);
+
+    for (int i = 0; i < demo1_tasks.size(); i++) {
+        example_task.add_task(Task(demo1_tasks[i]));
+        CHECK(stream.add_task(JointTask(demo1_tasks[i])) == i);
+    }
+    CartesianTask task1;
+    example_task.add_task(Task(task1));
+    stream.add_task(CartesianTask(task1), world);
+
+    example_task.start_position = get_Link6_home();
+    example_task.add_order_constraint(0, 1);
+    stream.add_order_constraint(0, 1);
+
+    example_task.setup(world);
+
+    TaskSequencingProblem streamed_task(manip);
+    CHECK(stream.finish(streamed_task));
+
+    REQUIRE(streamed_task.working_set.size() == example_task.working_set.size());
+    for (int i = 0; i < example_task.working_set.size(); i++) {
+        CHECK(streamed_task.working_set[i].task_id == example_task.working_set[i].task_id);
+        CHECK(is_close(streamed_task.working_set[i].start_position, example_task.working_set[i].start_position));
+        CHECK(is_close(streamed_task.working_set[i].end_position, example_task.working_set[i].end_position));
+    }
+    CHECK(is_close(streamed_task.cost, example_task.cost, 1e-9));
+    CHECK(is_close(streamed_task.cost_from_start, example_task.cost_from_start, 1e-9));
+    CHECK(is_close(streamed_task.minimum_cost_to_reach, example_task.minimum_cost_to_reach, 1e-9));
+    CHECK(is_close(streamed_task.task_domain, example_task.task_domain));
+    REQUIRE(streamed_task.phantom_following_constraints.size() == 1);
+    CHECK(streamed_task.phantom_following_constraints[0].earlier == example_task.phantom_following_constraints[0].earlier);
+    CHECK(streamed_task.phantom_following_constraints[0].later == example_task.phantom_following_constraints[0].later);
+    CHECK(streamed_task.joint_space_tasks.size() == example_task.joint_space_tasks.size());
+    CHECK(streamed_task.cartesian_space_tasks.size() == example_task.cartesian_space_tasks.size());
+    CHECK(stream.size() == 0);
+
+    // With the exact size the cost matrix is allocated once and moved into the problem
+    int n_joint_tasks = demo1_tasks.size();
+    TaskStream exact_stream(manip, get_Link6_home(), n_joint_tasks);
+    // A task which does not match the manipulator takes no id
+    std::cout << "Should give 1 error: " << std::endl;
+    CHECK(exact_stream.add_task(JointTask(manip.joints - 1)) == -1);
+    for (int i = 0; i < n_joint_tasks; i++) {
+        CHECK(exact_stream.add_task(JointTask(demo1_tasks[i])) == i);
+    }
+    CHECK(exact_stream.capacity == n_joint_tasks);
+    TaskSequencingProblem exact_task(manip);
+    CHECK(exact_stream.finish(exact_task));
+    REQUIRE(exact_task.cost.rows == n_joint_tasks);
+    REQUIRE(exact_task.cost.cols == n_joint_tasks);
+    for (int i = 0; i < n_joint_tasks; i++) {
+        CHECK(exact_task.working_set[i].task_id == i);
+        CHECK(is_close(exact_task.working_set[i].end_velocity, example_task.working_set[i].end_velocity));
+        for (int j = 0; j < n_joint_tasks; j++) {
+            CHECK(is_close(exact_task.cost(i, j), example_task.cost(i, j), 1e-9));
+        }
+    }
+
+    // Costs of a cost model are the ones setup() computes with it
+    std::vector<std::shared_ptr<CostModel>> cost_models = {std::make_shared<TrapezoidalCostModel>(), std::make_shared<SCurveCostModel>(Array(manip.joints, 10.0))};
+    for (const auto& cost_model : cost_models) {
+        TaskSequencingProblem model_task(manip);
+        model_task.cost_model = cost_model;
+        model_task.start_position = get_Link6_home();
+        TaskStream model_stream(manip, get_Link6_home(), n_joint_tasks, cost_model);
+        for (int i = 0; i < n_joint_tasks; i++) {
+            model_task.add_task(Task(demo1_tasks[i]));
+            model_stream.add_task(JointTask(demo1_tasks[i]));
+        }
+        model_task.setup(world);
+
+        TaskSequencingProblem streamed_model_task(manip);
+        REQUIRE(model_stream.finish(streamed_model_task));
+        CHECK(streamed_model_task.cost_model == cost_model);
+        CHECK(is_close(streamed_model_task.cost, model_task.cost, 1e-6));
+        CHECK(is_close(streamed_model_task.cost_from_start, model_task.cost_from_start, 1e-6));
+        CHECK(is_close(streamed_model_task.minimum_cost_to_reach, model_task.minimum_cost_to_reach, 1e-6));
+    }
+
+    // A problem which already has another cost model is left untouched
+    TaskStream s_curve_stream(manip, get_Link6_home(), 0, cost_models[1]);
+    s_curve_stream.add_task(JointTask(demo1_tasks[0]));
+    TaskSequencingProblem trapezoidal_task(manip);
+    trapezoidal_task.cost_model = cost_models[0];
+    std::cout << "Should give 1 error: " << std::endl;
+    CHECK(!s_curve_stream.finish(trapezoidal_task));
+    CHECK(s_curve_stream.size() == 1);
+    CHECK(trapezoidal_task.working_set.size() == 0);
+}
+
+TEST_CASE("TrapezoidalCostModel struct: evaluate() function test", "[Task]") {
+    auto manip = get_generic_Link6();
+    auto demo1_tasks = get_Link6_demo1_tasks_simple();
+    
+    JointTask joint_task(demo1_tasks[0]);
+    TrapezoidalCostModel cost_model;
+
+    // At rest, same as trapezoidal_velocity_profile_time()
+    MotionProfile profile;
+    auto result = cost_model.evaluate(joint_task.start_position, {}, joint_task.end_position, {}, manip, &profile);
+    CHECK(is_close(result, trapezoidal_velocity_profile_time(joint_task, manip)));
+    CHECK(is_close(profile.duration, result));
+
+    // Non zero boundary velocities, every joint reaches its end state at the same time
+    Array start_velocity(manip.joints);
+    Array end_velocity(manip.joints);
+    for (int i = 0; i < manip.joints; i++) {
+        start_velocity[i] = 0.1*sign(joint_task.end_position[i] - joint_task.start_position[i]);
+        end_velocity[i] = 0.05*sign(joint_task.end_position[i] - joint_task.start_position[i]);
+    }
+    result = cost_model.evaluate(joint_task.start_position, start_velocity, joint_task.end_position, end_velocity, manip, &profile);
+    CHECK(result > 0);
+    CHECK(is_close(result, cost_model.evaluate(joint_task.start_position, start_velocity, joint_task.end_position, end_velocity, manip)));
+
+    Array position, velocity, acceleration;
+    profile.sample(0, position, velocity, acceleration);
+    CHECK(is_close(position, joint_task.start_position, 1e-6));
+    CHECK(is_close(velocity, start_velocity, 1e-6));
+    profile.sample(profile.duration, position, velocity, acceleration);
+    CHECK(is_close(position, joint_task.end_position, 1e-6));
+    CHECK(is_close(velocity, end_velocity, 1e-6));
+    for (int i = 0; i < manip.joints; i++) {
+        CHECK(is_close(profile.joints[i].duration(), profile.duration, 1e-6));
+    }
+
+    // Boundary velocities pointing away from the target
+    for (int i = 0; i < manip.joints; i++) {
+        start_velocity[i] = -start_velocity[i];
+    }
+    result = cost_model.evaluate(joint_task.start_position, start_velocity, joint_task.end_position, end_velocity, manip, &profile);
+    profile.sample(result, position, velocity, acceleration);
+    CHECK(is_close(position, joint_task.end_position, 1e-6));
+    CHECK(is_close(velocity, end_velocity, 1e-6));
+
+    // A joint too close to its target to meet its boundary velocities is stretched like the others
+    Array start_position(manip.joints);
+    Array end_position(manip.joints);
+    start_velocity = Array(manip.joints);
+    end_velocity = Array(manip.joints);
+    end_position[0] = 2;
+    end_position[1] = 1e-3;
+    start_velocity[1] = 0.5*manip.vmax[1];
+    end_velocity[1] = 0.1*manip.vmax[1];
+    result = cost_model.evaluate(start_position, start_velocity, end_position, end_velocity, manip, &profile);
+    CHECK(profile.synchronized);
+    CHECK(is_close(profile.joints[1].duration(), result, 1e-6));
+    profile.sample(result, position, velocity, acceleration);
+    CHECK(is_close(position, end_position, 1e-6));
+    CHECK(is_close(velocity, end_velocity, 1e-6));
+}
+
+TEST_CASE("Task struct: setup() with cost_model function test", "[Task]") {
+    auto manip = get_generic_Link6();
+    World world;
+    auto demo1_tasks = get_Link6_demo1_tasks_simple();
+    
+    TaskSequencingProblem example_task(manip);
+
+    for (int i = 0; i < demo1_tasks.size(); i++) {
+        example_task.add_task(Task(demo1_tasks[i]));
+    }
+
+    example_task.start_position = get_Link6_home();
+    auto legacy_task = example_task;
+
+    example_task.cost_model = std::make_shared<TrapezoidalCostModel>();
+    example_task.cache_profiles = true;
+    example_task.setup(world);
+    legacy_task.setup(world);
+
+    int n_tasks = example_task.working_set.size();
+    REQUIRE(example_task.profiles.size() == n_tasks*n_tasks);
+    REQUIRE(example_task.profiles_from_start.size() == n_tasks);
+
+    // Tasks are at rest, so costs are unchanged
+    CHECK(is_close(example_task.cost, legacy_task.cost, 1e-9));
+    CHECK(is_close(example_task.cost_from_start, legacy_task.cost_from_start, 1e-9));
+    for (int i = 0; i < n_tasks; i++) {
+        CHECK(is_close(example_task.profiles_from_start[i].duration, example_task.cost_from_start[i]));
+        for (int j = 0; j < n_tasks; j++) {
+            CHECK(is_close(example_task.profiles[j*n_tasks + i].duration, example_task.cost(j, i)));
+        }
+    }
+}
+TEST_CASE("s_curve_velocity_profile_time() function test", "[Task]") {
+    auto manip = get_generic_Link6();
+    auto demo1_tasks = get_Link6_demo1_tasks_simple();
+    JointTask joint_task(demo1_tasks[0]);
+
+    for (int i = 0; i < manip.joints; i++) {
+        real displacement = joint_task.end_position[i] - joint_task.start_position[i];
+        real trapezoidal = trapezoidal_velocity_profile_time(displacement, manip.vmax[i], manip.vmin[i], manip.amax[i], manip.amin[i]);
+
+        // Limiting jerk can only slow the move down, and infinite jerk is the trapezoidal profile
+        CHECK(s_curve_velocity_profile_time(displacement, manip.vmax[i], manip.vmin[i], manip.amax[i], manip.amin[i], 10*manip.amax[i]) >= trapezoidal);
+        CHECK(is_close(s_curve_velocity_profile_time(displacement, manip.vmax[i], manip.vmin[i], manip.amax[i], manip.amin[i], 1e9), trapezoidal, 1e-4));
+    }
+
+    // Short move never reaching the acceleration limit: 2*v^1.5/sqrt(j) = d, over 4*sqrt(v/j)
+    real d = 0.001;
+    real j = 10;
+    real v = std::cbrt(0.5*d*std::sqrt(j));
+    v = v*v;
+    CHECK(is_close(s_curve_velocity_profile_time(-d, 1, -1, 10, -10, j), 4*std::sqrt(v/j), 1e-9));
+    CHECK(s_curve_velocity_profile_time(0, 1, -1, 10, -10, j) == 0);
+
+    // Long move at the acceleration limit, even with j/a^2 far above 1: v*(v/a + a/j) = d, over 2*(v/a + a/j)
+    real a = 0.5;
+    for (real j : {1e5, 1e9}) {
+        real v = (-a/j + std::sqrt(a*a/(j*j) + 4*d/a))/(2/a);
+        CHECK(is_close(s_curve_velocity_profile_time(d, 10, -10, a, -a, j), 2*(v/a + a/j), 1e-9));
+    }
+
+    // Batched kernel gives the scalar result, over several chunks and with accelerations 4 times apart, which some
+    // displacements need more than the fixed Newton steps for
+    std::vector<real> displacements;
+    for (int k = -300; k <= 300; k++) {
+        displacements.push_back(0.01*k);
+    }
+    for (real j : {20.0, 1e5}) {
+        std::vector<real> times(displacements.size());
+        s_curve_velocity_profile_time(displacements.data(), displacements.size(), 1.5, -1, 4, -1, j, times.data());
+        for (int k = 0; k < displacements.size(); k++) {
+            CHECK(times[k] == s_curve_velocity_profile_time(displacements[k], 1.5, -1, 4, -1, j));
+        }
+    }
+}
+
+TEST_CASE("SCurveCostModel struct: evaluate() function test", "[Task]") {
+    auto manip = get_generic_Link6();
+    auto demo1_tasks = get_Link6_demo1_tasks_simple();
+    JointTask joint_task(demo1_tasks[0]);
+
+    Array jmax(manip.joints, 5.0);
+    SCurveCostModel cost_model(jmax);
+
+    MotionProfile profile;
+    auto result = cost_model.evaluate(joint_task.start_position, {}, joint_task.end_position, {}, manip, &profile);
+    CHECK(result >= trapezoidal_velocity_profile_time(joint_task, manip));
+    CHECK(is_close(profile.duration, result));
+
+    // Synchronized joints all reach the end at rest, at the same time
+    Array position, velocity, acceleration;
+    profile.sample(0, position, velocity, acceleration);
+    CHECK(is_close(position, joint_task.start_position, 1e-6));
+    profile.sample(profile.duration, position, velocity, acceleration);
+    CHECK(is_close(position, joint_task.end_position, 1e-6));
+    CHECK(is_close(velocity, Array(manip.joints, 0.0), 1e-6));
+    CHECK(is_close(acceleration, Array(manip.joints, 0.0), 1e-6));
+    for (int i = 0; i < manip.joints; i++) {
+        CHECK(is_close(profile.joints[i].duration(), profile.duration, 1e-6));
+    }
+
+    // A model shared between threads: batches of different sizes evaluated at once give the sequential times
+    std::vector<int> n_targets = {300, 700};
+    std::vector<std::vector<real>> targets(2);
+    std::vector<std::vector<real>> expected(2);
+    for (int t = 0; t < 2; t++) {
+        for (int k = 0; k < manip.joints*n_targets[t]; k++) {
+            targets[t].push_back(0.01*((k*(t + 3)) % 401) - 2);
+        }
+        expected[t].resize(n_targets[t]);
+        cost_model.evaluate_batch(joint_task.start_position, targets[t].data(), n_targets[t], manip, expected[t].data());
+    }
+    std::vector<int> n_mismatches(2, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 2; t++) {
+        threads.emplace_back([&, t]() {
+            std::vector<real> times(n_targets[t]);
+            for (int repeat = 0; repeat < 200; repeat++) {
+                cost_model.evaluate_batch(joint_task.start_position, targets[t].data(), n_targets[t], manip, times.data());
+                n_mismatches[t] += times != expected[t];
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    CHECK(n_mismatches == std::vector<int>{0, 0});
+}
+
+TEST_CASE("Task struct: setup() with SCurveCostModel function test", "[Task]") {
+    auto manip = get_generic_Link6();
+    World world;
+    auto demo1_tasks = get_Link6_demo1_tasks_simple();
+    
+    TaskSequencingProblem example_task(manip);
+
+    for (int i = 0; i < demo1_tasks.size(); i++) {
+        example_task.add_task(Task(demo1_tasks[i]));
+    }
+
+    example_task.start_position = get_Link6_home();
+    example_task.cost_model = std::make_shared<SCurveCostModel>(Array(manip.joints, 5.0));
+    auto profiled_task = example_task;
+
+    // Batched rows, and evaluate() pair by pair when profiles are kept
+    example_task.setup(world);
+    profiled_task.cache_profiles = true;
+    profiled_task.setup(world);
+
+    CHECK(is_close(example_task.cost, profiled_task.cost, 1e-9));
+    CHECK(is_close(example_task.cost_from_start, profiled_task.cost_from_start, 1e-9));
+    CHECK(is_close(example_task.minimum_cost_to_reach, profiled_task.minimum_cost_to_reach, 1e-9));
+}
@@ -0,0 +1,142 @@
+#define CATCH_CONFIG_MAIN
+#define TRACING
+#include "catch2/catch.hpp"
+#include "../tracing.hpp"
+#include "../constraints_satisfaction_problem.hpp"
+#include <sstream>
+#include <thread>
+
+std::string read_file(const std::string& path) {
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+int count_occurrences(const std::string& text, const std::string& pattern) {
+    int count = 0;
+    for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1)) {
+        count++;
+    }
+    return count;
+}
+
+TEST_CASE("TRACE_ZONE macro test", "[Tracing]") {
+    clear_trace();
+    {
+        TRACE_ZONE("outer");
+        for (int i = 0; i < 3; i++) {
+            TRACE_ZONE("inner");
+            TRACE_COUNTER("i", i);
+        }
+        TRACE_ZONE_NAMED(named, "named");
+        TRACE_ZONE_END(named);
+        // Ending twice records once
+        TRACE_ZONE_END(named);
+    }
+    CHECK(trace_size() == 8);
+
+    auto& buffer = trace_buffer();
+    uint64_t head = buffer.head.load();
+    REQUIRE(head == 8);
+    // Zones are recorded when they end, the outer one last
+    const auto& outer = buffer.events[7];
+    CHECK(std::string(outer.name) == "outer");
+    for (int k = 0; k < 7; k++) {
+        const auto& event = buffer.events[k];
+        CHECK(event.start_ns >= outer.start_ns);
+        if (event.duration_ns >= 0) {
+            CHECK(event.start_ns + event.duration_ns <= outer.start_ns + outer.duration_ns);
+        }
+    }
+    // The counter of each iteration comes before its zone, which ends after it
+    CHECK(buffer.events[0].duration_ns == -1);
+    CHECK(buffer.events[2].value == 1);
+    CHECK(std::string(buffer.events[3].name) == "inner");
+}
+
+TEST_CASE("write_chrome_trace() function test", "[Tracing]") {
+    clear_trace();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 3; t++) {
+        threads.emplace_back([]() {
+            for (int i = 0; i < 100; i++) {
+                TRACE_ZONE("worker \"zone\"");
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    {
+        TRACE_ZONE("main");
+    }
+
+    std::string path = "tracing_test.json";
+    REQUIRE(write_chrome_trace(path));
+    auto json = read_file(path);
+    std::remove(path.c_str());
+    CHECK(json.rfind("{\"traceEvents\":[", 0) == 0);
+    CHECK(count_occurrences(json, "\"name\":\"worker \\\"zone\\\"\"") == 300);
+    CHECK(count_occurrences(json, "\"name\":\"main\"") == 1);
+    CHECK(count_occurrences(json, "\"ph\":\"X\"") == 301);
+
+    // Buffers of threads that exited are taken over rather than added. The workers may all have run on one buffer that
+    // main took over since, a thread exiting first leaves one free.
+    std::thread([]() { TRACE_ZONE("first"); }).join();
+    size_t n_buffers = trace_registry().buffers.size();
+    std::thread([]() { TRACE_ZONE("later"); }).join();
+    CHECK(trace_registry().buffers.size() == n_buffers);
+}
+
+TEST_CASE("TraceBuffer struct: record() overwrites the oldest events test", "[Tracing]") {
+    clear_trace();
+    auto& buffer = trace_buffer();
+    int capacity = buffer.events.size();
+    for (int i = 0; i < capacity + 10; i++) {
+        TRACE_COUNTER("step", i);
+    }
+    CHECK(trace_size() == capacity);
+    // The oldest kept event is the 11th one
+    CHECK(buffer.events[10].value == 10);
+    CHECK(buffer.events[9].value == capacity + 9);
+}
+
+// x < y between two variables
+struct TracingLessThan : CSP_Constraint {
+    TracingLessThan(CSP_Variable& var_1, CSP_Variable& var_2) {
+        input_var = {&var_1};
+        output_var = {&var_2};
+        var_1.from_arcs.push_back(this);
+        var_2.to_arcs.push_back(this);
+    }
+
+    bool consistent(CSP_Assignment a, int x) override {
+        return a[input_var[0]->idx] < x;
+    }
+};
+
+TEST_CASE("CSP search trace test", "[Tracing]") {
+    clear_trace();
+    // x0 < x1 < x2 over 0 to 2
+    CSP problem;
+    problem.variables.resize(3);
+    for (auto& variable : problem.variables) {
+        variable = std::make_unique<CSP_Variable>();
+        variable->domain = CSP_Domain(3);
+        for (int x = 0; x < 3; x++) {
+            variable->domain.insert(x);
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        problem.constraints.push_back(std::make_unique<TracingLessThan>(*problem.variables[i], *problem.variables[i+1]));
+    }
+    CHECK(problem.backtrack_mac() == std::vector<int>{0, 1, 2});
+
+    std::string path = "tracing_csp_test.json";
+    REQUIRE(write_chrome_trace(path));
+    auto json = read_file(path);
+    std::remove(path.c_str());
+    CHECK(count_occurrences(json, "\"name\":\"CSP search\"") == 1);
+    CHECK(count_occurrences(json, "\"name\":\"CSP initial propagation\"") == 1);
+}
@@ -0,0 +1,188 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Scoped zones and counters recorded per thread, written out as Chrome trace JSON by write_chrome_trace() (open it in
+// chrome://tracing or ui.perfetto.dev). The macros are compiled in with TRACING defined (cmake -DTRACING=ON), otherwise
+// they expand to nothing and the instrumented code is unchanged.
+//
+//     TRACE_ZONE("A_star");                     // Until the end of the scope
+//     TRACE_ZONE_NAMED(costs, "setup costs");   // Until TRACE_ZONE_END(costs) or the end of the scope
+//     TRACE_COUNTER("open nodes", n);
+#if defined(TRACING)
+    #define TRACE_CONCAT_(a, b) a##b
+    #define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+    #define TRACE_ZONE(name) TraceZone TRACE_CONCAT(trace_zone_, __LINE__)(name)
+    #define TRACE_ZONE_NAMED(zone, name) TraceZone zone(name)
+    #define TRACE_ZONE_END(zone) zone.end()
+    #define TRACE_COUNTER(name, value) trace_counter(name, value)
+#else
+    #define TRACE_ZONE(name)
+    #define TRACE_ZONE_NAMED(zone, name)
+    #define TRACE_ZONE_END(zone)
+    #define TRACE_COUNTER(name, value)
+#endif
+
+struct TraceEvent {
+    const char* name;    // Only the pointer is kept, names must be string literals
+    int64_t start_ns;    // Since the first event of the process
+    int64_t duration_ns; // -1 for a counter
+    double value;        // Of a counter
+};
+
+// Events of one thread in a ring buffer, the oldest ones are overwritten once it is full. Only the thread using it
+// records, so recording takes no lock: the event is written, then head is published with a release store.
+struct TraceBuffer {
+    std::vector<TraceEvent> events; // Size is a power of two
+    std::atomic<uint64_t> head{0};  // Events recorded so far, the last events.size() of them are kept
+    std::atomic<bool> in_use{false};
+    int thread_id = 0;
+
+    void record(const TraceEvent& event) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        events[h & (events.size() - 1)] = event;
+        head.store(h + 1, std::memory_order_release);
+    }
+};
+
+// Buffers of every thread that recorded events. A thread that exits gives its buffer back, the next thread to record
+// takes it over along with its events, so short lived workers do not pile up buffers.
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    size_t capacity = 1 << 16; // Events per buffer, a power of two. Only buffers created afterwards use a new value.
+
+    TraceBuffer* acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& buffer : buffers) {
+            if (!buffer->in_use.load(std::memory_order_acquire)) {
+                buffer->in_use = true;
+                return buffer.get();
+            }
+        }
+        buffers.emplace_back(new TraceBuffer());
+        auto buffer = buffers.back().get();
+        buffer->events.resize(capacity);
+        buffer->thread_id = buffers.size() - 1;
+        buffer->in_use = true;
+        return buffer;
+    }
+};
+
+inline TraceRegistry& trace_registry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+// Buffer of the calling thread
+inline TraceBuffer& trace_buffer() {
+    struct Holder {
+        TraceBuffer* buffer = nullptr;
+        ~Holder() {
+            if (buffer) {
+                buffer->in_use.store(false, std::memory_order_release);
+            }
+        }
+    };
+    thread_local Holder holder;
+    if (!holder.buffer) {
+        holder.buffer = trace_registry().acquire();
+    }
+    return *holder.buffer;
+}
+
+inline int64_t trace_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - trace_registry().epoch).count();
+}
+
+struct TraceZone {
+    const char* name;
+    int64_t start_ns;
+    bool open = true;
+
+    explicit TraceZone(const char* new_name) : name(new_name), start_ns(trace_now_ns()) {}
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+    ~TraceZone() { end(); }
+
+    void end() {
+        if (open) {
+            trace_buffer().record({name, start_ns, trace_now_ns() - start_ns, 0});
+            open = false;
+        }
+    }
+};
+
+inline void trace_counter(const char* name, double value) {
+    trace_buffer().record({name, trace_now_ns(), -1, value});
+}
+
+// Forgets every event recorded so far
+// note: Like write_chrome_trace(), only exact while no other thread records events
+inline void clear_trace() {
+    auto& registry = trace_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (auto& buffer : registry.buffers) {
+        buffer->head.store(0, std::memory_order_release);
+    }
+}
+
+// Number of events kept over every buffer
+inline size_t trace_size() {
+    auto& registry = trace_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    size_t n_events = 0;
+    for (auto& buffer : registry.buffers) {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        n_events += head < buffer->events.size() ? head : buffer->events.size();
+    }
+    return n_events;
+}
+
+// Writes the events kept by every thread as a Chrome trace JSON object, zones as complete ("X") events and counters as
+// "C" events, times in microseconds. Returns false when the file cannot be written.
+// note: Meant to be called once the traced work is over, events recorded meanwhile can be missed or overwritten.
+inline bool write_chrome_trace(const std::string& path) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Error : Could not open " << path << " for writing" << std::endl;
+        return false;
+    }
+    auto& registry = trace_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    file << "{\"traceEvents\":[";
+    bool first = true;
+    file.setf(std::ios::fixed);
+    file.precision(3);
+    for (auto& buffer : registry.buffers) {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t n_kept = head < buffer->events.size() ? head : buffer->events.size();
+        for (uint64_t k = head - n_kept; k < head; k++) {
+            const auto& event = buffer->events[k & (buffer->events.size() - 1)];
+            file << (first ? "\n" : ",\n") << "{\"name\":\"";
+            for (const char* c = event.name; *c; c++) {
+                if (*c == '"' || *c == '\\') {
+                    file << '\\';
+                }
+                file << *c;
+            }
+            file << "\",\"pid\":0,\"tid\":" << buffer->thread_id << ",\"ts\":" << event.start_ns / 1000.0;
+            if (event.duration_ns >= 0) {
+                file << ",\"ph\":\"X\",\"dur\":" << event.duration_ns / 1000.0 << "}";
+            } else {
+                file << ",\"ph\":\"C\",\"args\":{\"value\":" << event.value << "}}";
+            }
+            first = false;
+        }
+    }
+    file << "\n]}\n";
+    return (bool)file;
+}